@@ -0,0 +1,140 @@
+// Clock cycles and threads the MATCH_SET extension saves on the test corpus.
+//
+// Every sampled program is rewritten by ClassRewriter, and every input
+// matched on the cycle accurate engine against both versions, without the
+// prefilter. The report sums the classes rewritten, the reachable
+// instructions, and the simulated clock cycles, instructions executed and
+// threads pushed to the buffers by the matches; the verdicts of the two
+// versions must agree.
+//
+// Usage: bench_classes [program stride] [window size]
+
+#include "CiceroMulti.h"
+#include "ClassRewriter.h"
+#include "DecodedProgram.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const int PROGRAMS_COUNT = 1308;
+
+struct Totals {
+    size_t instructions = 0; // Reachable
+    uint64_t cycles = 0;
+    uint64_t executed = 0;
+    uint64_t threads = 0;
+    unsigned int highWaterMark = 0;
+};
+
+size_t countReachable(const Cicero::DecodedProgram &program) {
+    size_t count = 0;
+    for (int PC = 0; PC < Cicero::INSTR_MEM_SIZE; PC++) {
+        count += program.isReachable(PC);
+    }
+    return count;
+}
+
+bool match(Cicero::BasicEngine<Cicero::StatsProbe> &engine,
+           const std::string &input, Totals &totals) {
+    bool verdict = engine.runMultiChar(input);
+    const Cicero::EngineStats &stats = engine.getProbe().getStats();
+    totals.cycles += stats.clockCycles;
+    for (uint64_t count : stats.instructions) {
+        totals.executed += count;
+    }
+    totals.threads += stats.threads;
+    for (unsigned int mark : stats.highWaterMarks) {
+        totals.highWaterMark = std::max(totals.highWaterMark, mark);
+    }
+    return verdict;
+}
+
+void printRow(const char *name, uint64_t original, uint64_t rewritten) {
+    printf("%-20s %12llu %12llu %7.2f%%\n", name,
+           (unsigned long long)original, (unsigned long long)rewritten,
+           100.0 * (double(original) - double(rewritten)) / original);
+}
+
+int main(int argc, char **argv) {
+    int stride = argc > 1 ? std::max(1, std::stoi(argv[1])) : 10;
+    int W = argc > 2 ? std::max(1, std::stoi(argv[2])) : 1;
+
+    std::ifstream stringsFile(CORPUS_PATH + std::string("strings.txt"));
+    std::vector<std::string> inputs;
+    std::string buffer;
+    while (std::getline(stringsFile, buffer)) {
+        inputs.push_back(buffer);
+    }
+    if (inputs.empty()) {
+        std::cerr << "Unable to read strings.txt from " << CORPUS_PATH
+                  << std::endl;
+        return -1;
+    }
+
+    Cicero::ClassRewriterStats rewrites;
+    size_t programCount = 0;
+    size_t classCount = 0;
+    Totals original;
+    Totals rewritten;
+    Cicero::Instruction program[Cicero::INSTR_MEM_SIZE];
+    Cicero::DecodedProgram decoded;
+    Cicero::DecodedProgram decodedClasses;
+    Cicero::BasicEngine<Cicero::StatsProbe> engine(decoded, W + 1);
+    Cicero::BasicEngine<Cicero::StatsProbe> classEngine(decodedClasses, W + 1);
+
+    for (int i = 0; i <= PROGRAMS_COUNT; i += stride) {
+        std::string path =
+            CORPUS_PATH + std::string("programs/") + std::to_string(i);
+        std::fill(program, program + Cicero::INSTR_MEM_SIZE,
+                  Cicero::Instruction());
+        if (!std::ifstream(path).good() ||
+            !Cicero::CiceroMulti::readProgram(path.c_str(), program))
+            continue;
+
+        Cicero::ClassRewriter rewriter(program);
+        const Cicero::ClassRewriterStats &stats = rewriter.getStats();
+        decoded.decode(program);
+        decodedClasses.decode(rewriter.getProgram().data(),
+                              rewriter.getClasses());
+        engine.setProgram(decoded);
+        classEngine.setProgram(decodedClasses);
+
+        programCount++;
+        rewrites.alternations += stats.alternations;
+        rewrites.negations += stats.negations;
+        rewrites.largestClass =
+            std::max(rewrites.largestClass, stats.largestClass);
+        classCount += rewriter.getClasses().size();
+        original.instructions += countReachable(decoded);
+        rewritten.instructions += countReachable(decodedClasses);
+
+        for (auto &input : inputs) {
+            bool verdict = match(engine, input, original);
+            if (match(classEngine, input, rewritten) != verdict) {
+                std::cerr << "Program " << i << " with MATCH_SET does not "
+                          << "match " << input << " as the original does.\n";
+                return -1;
+            }
+        }
+    }
+
+    printf("%zu programs x %zu inputs, W = %d\n\n", programCount,
+           inputs.size(), W);
+    printf("alternations         %10zu\n", rewrites.alternations);
+    printf("negations            %10zu\n", rewrites.negations);
+    printf("class table entries  %10zu (largest %zu characters)\n\n",
+           classCount, rewrites.largestClass);
+    printf("%-20s %12s %12s %8s\n", "", "original", "MATCH_SET", "saved");
+    printRow("instructions", original.instructions, rewritten.instructions);
+    printRow("clock cycles", original.cycles, rewritten.cycles);
+    printRow("executed", original.executed, rewritten.executed);
+    printRow("threads", original.threads, rewritten.threads);
+    printRow("peak FIFO threads", original.highWaterMark,
+             rewritten.highWaterMark);
+    return 0;
+}
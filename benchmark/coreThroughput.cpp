@@ -0,0 +1,166 @@
+// Host cost of simulating the CICERO core on the test corpus.
+//
+// Every sampled program matches every input on the cycle accurate engine,
+// without the prefilter, for each window size W. The report gives, per input
+// character, the simulated clock cycles and the host CPU cycles spent
+// simulating them (read from the time stamp counter on x86-64, derived from
+// the elapsed time elsewhere), and the host nanoseconds per simulated clock
+// cycle. The best of the repetitions is kept.
+//
+// Usage: bench_core [program stride] [repetitions] [windows, e.g. 1,2,4,8]
+//                   [baseline]
+//
+// The baseline is the output of an earlier run, kept in a file: the host
+// cycles per character of each window size are then compared with it.
+
+#include "CiceroMulti.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC 1
+#endif
+
+const int PROGRAMS_COUNT = 1308;
+
+uint64_t readCycles() {
+#ifdef HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Host cycles per character by window size, from the rows of a report.
+std::map<int, double> readBaseline(const char *path) {
+    std::map<int, double> baseline;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        int W;
+        unsigned long long simulated;
+        double simulatedPerChar, hostPerChar, nanoseconds;
+        if (sscanf(line.c_str(), "%d %llu %lf %lf %lf", &W, &simulated,
+                   &simulatedPerChar, &hostPerChar, &nanoseconds) == 5)
+            baseline[W] = hostPerChar;
+    }
+    return baseline;
+}
+
+int main(int argc, char **argv) {
+    int stride = argc > 1 ? std::max(1, std::stoi(argv[1])) : 10;
+    int repetitions = argc > 2 ? std::max(1, std::stoi(argv[2])) : 3;
+    std::vector<int> windows = {1, 2, 4, 8};
+    if (argc > 3) {
+        windows.clear();
+        std::istringstream list(argv[3]);
+        std::string W;
+        while (std::getline(list, W, ',')) {
+            windows.push_back(std::max(1, std::stoi(W)));
+        }
+    }
+    std::map<int, double> baseline;
+    if (argc > 4) {
+        baseline = readBaseline(argv[4]);
+        if (baseline.empty()) {
+            std::cerr << "No results to compare with in " << argv[4]
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::ifstream stringsFile(CORPUS_PATH + std::string("strings.txt"));
+    std::vector<std::string> inputs;
+    std::string buffer;
+    while (std::getline(stringsFile, buffer)) {
+        inputs.push_back(buffer);
+    }
+    if (inputs.empty()) {
+        std::cerr << "Unable to read strings.txt from " << CORPUS_PATH
+                  << std::endl;
+        return -1;
+    }
+
+    std::vector<std::vector<Cicero::Instruction>> programs;
+    for (int i = 0; i <= PROGRAMS_COUNT; i += stride) {
+        std::string path =
+            CORPUS_PATH + std::string("programs/") + std::to_string(i);
+        programs.emplace_back(Cicero::INSTR_MEM_SIZE);
+        if (!std::ifstream(path).good() ||
+            !Cicero::CiceroMulti::readProgram(path.c_str(),
+                                              programs.back().data()))
+            programs.pop_back();
+    }
+    if (programs.empty()) {
+        std::cerr << "Unable to read any program from " << CORPUS_PATH
+                  << "programs" << std::endl;
+        return -1;
+    }
+
+    printf("%zu programs x %zu inputs, best of %d\n\n", programs.size(),
+           inputs.size(), repetitions);
+    printf("%-4s %14s %14s %14s %14s", "W", "sim cycles", "sim/char",
+           "host/char", "ns/sim cycle");
+    printf(baseline.empty() ? "\n" : " %14s\n", "vs baseline");
+
+    for (int W : windows) {
+        Cicero::Engine engine(programs.front().data(), W + 1);
+        uint64_t simulated = 0;
+        uint64_t characters = 0;
+        double bestSeconds = 0;
+        uint64_t bestCycles = 0;
+
+        for (int repetition = 0; repetition < repetitions; repetition++) {
+            simulated = 0;
+            characters = 0;
+            auto start = std::chrono::steady_clock::now();
+            uint64_t startCycles = readCycles();
+
+            for (auto &program : programs) {
+                engine.setProgram(program.data());
+                for (auto &input : inputs) {
+                    engine.runMultiChar(input);
+                    simulated += engine.getClockCycles();
+                    characters += input.size() + 1;
+                }
+            }
+
+            uint64_t cycles = readCycles() - startCycles;
+            double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+            if (repetition == 0 || seconds < bestSeconds) {
+                bestSeconds = seconds;
+                bestCycles = cycles;
+            }
+        }
+
+#ifndef HAS_TSC
+        // Nominal 1 GHz, so that host/char reads as nanoseconds.
+        bestCycles = uint64_t(bestSeconds * 1e9);
+#endif
+        double hostPerChar = double(bestCycles) / characters;
+        printf("%-4d %14llu %14.2f %14.2f %14.3f", W,
+               (unsigned long long)simulated, double(simulated) / characters,
+               hostPerChar, bestSeconds * 1e9 / simulated);
+        // The speedup over the baseline, or - if it lacks this window size.
+        auto base = baseline.find(W);
+        if (baseline.empty())
+            printf("\n");
+        else if (base == baseline.end())
+            printf(" %14s\n", "-");
+        else
+            printf(" %13.2fx\n", base->second / hostPerChar);
+    }
+    return 0;
+}
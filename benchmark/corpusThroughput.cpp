@@ -0,0 +1,384 @@
+// Throughput and latency of every execution mode over the test corpus.
+//
+// Each configuration (execution mode, and window size W for the cycle
+// accurate mode) matches every input against every sampled program, and
+// reports:
+//
+//   matches/s    match calls per second
+//   MB/s         input bytes matched per second
+//   cycles/char  simulated clock cycles per input character (cycle mode)
+//   p50, p99     latency of a single match call, in microseconds
+//
+// The "set" configuration links the sampled programs into a PatternSet and
+// matches each input against all of them at once; its latency is that of one
+// input against every program. The "lockstep" configuration matches all the
+// inputs against each program at once; its latency is that of every input
+// against one program. The "jit" configuration runs the programs compiled to
+// native code; the time spent compiling them, or loading them from the
+// cache, is not counted, but compiling the sample takes minutes, so it only
+// runs when asked for. The verdicts of all configurations are checked
+// against each other.
+//
+// The programs are matched behind their prefilter, which skips the engines
+// for most inputs; --no-prefilter measures the engines on every input. The
+// cycle accurate mode always runs without it, so that cycles/char counts
+// every input. With --dedup the cycle accurate engines drop duplicate
+// threads.
+//
+// Usage: bench_corpus [--json] [--stride N]
+//                     [--modes cycle,pike,dfa,bit,lockstep,set,jit]
+//                     [--windows 1,2,4,8] [--no-prefilter] [--dedup]
+//
+// With --json, the results are printed as a single JSON object, to be kept
+// and compared between releases.
+
+#include "CiceroMulti.h"
+#include "PatternSet.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const int PROGRAMS_COUNT = 1308;
+// The engines take the window plus one as an unsigned short.
+const unsigned long MAX_WINDOW = 65534;
+
+struct Result {
+    std::string mode;
+    int W; // 0 when the window size does not apply
+    size_t matches;
+    size_t bytes;
+    double seconds;
+    double cycles; // Total simulated clock cycles, 0 if not simulated
+    double p50;    // Microseconds
+    double p99;
+};
+
+std::vector<std::string> splitList(const std::string &list) {
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+// As in the cicero tool: the whole of text must be a number in range.
+bool parseNumber(const char *option, const std::string &text,
+                 unsigned long min, unsigned long max, int &value) {
+    char *end;
+    errno = 0;
+    if (isdigit((unsigned char)text[0])) {
+        unsigned long number = strtoul(text.c_str(), &end, 10);
+        if (errno == 0 && *end == '\0' && number >= min && number <= max) {
+            value = number;
+            return true;
+        }
+    }
+    fprintf(stderr, "[X] %s takes numbers from %lu to %lu, not %s.\n", option,
+            min, max, text.c_str());
+    return false;
+}
+
+double percentile(std::vector<double> &latencies, double fraction) {
+    if (latencies.empty())
+        return 0;
+    size_t rank = std::min(latencies.size() - 1,
+                           size_t(fraction * (latencies.size() - 1) + 0.5));
+    std::nth_element(latencies.begin(), latencies.begin() + rank,
+                     latencies.end());
+    return latencies[rank];
+}
+
+Result runMode(Cicero::ExecutionMode mode, int W, bool prefilter,
+               bool deduplicate, const std::vector<std::string> &programs,
+               const std::vector<std::string> &inputs,
+               std::vector<bool> &verdicts) {
+    Cicero::CiceroMulti cicero(W, false, mode);
+    cicero.setPrefilter(prefilter && mode != Cicero::CYCLE_ACCURATE);
+    cicero.setDeduplication(deduplicate);
+    std::vector<double> latencies;
+    Result result = {"", W, 0, 0, 0, 0, 0, 0};
+
+    for (auto &program : programs) {
+        cicero.setProgram(program.c_str());
+
+        for (auto &input : inputs) {
+            auto start = std::chrono::steady_clock::now();
+            bool verdict = cicero.match(input);
+            double elapsed = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+
+            verdicts.push_back(verdict);
+            latencies.push_back(elapsed * 1e6);
+            result.seconds += elapsed;
+            result.bytes += input.size();
+            result.matches++;
+            if (mode == Cicero::CYCLE_ACCURATE)
+                result.cycles += cicero.getClockCycles();
+        }
+    }
+
+    result.p50 = percentile(latencies, 0.50);
+    result.p99 = percentile(latencies, 0.99);
+    return result;
+}
+
+Result runLockstep(bool prefilter, const std::vector<std::string> &programs,
+                   const std::vector<std::string> &inputs,
+                   std::vector<bool> &verdicts) {
+    Cicero::CiceroMulti cicero(1, false, Cicero::LOCKSTEP);
+    cicero.setPrefilter(prefilter);
+    std::vector<double> latencies;
+    Result result = {"", 0, 0, 0, 0, 0, 0, 0};
+
+    for (auto &program : programs) {
+        cicero.setProgram(program.c_str());
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<unsigned char> matching = cicero.matchAll(inputs);
+        double elapsed = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+        verdicts.insert(verdicts.end(), matching.begin(), matching.end());
+        latencies.push_back(elapsed * 1e6);
+        result.seconds += elapsed;
+        for (auto &input : inputs) {
+            result.bytes += input.size();
+        }
+        result.matches += inputs.size();
+    }
+
+    result.p50 = percentile(latencies, 0.50);
+    result.p99 = percentile(latencies, 0.99);
+    return result;
+}
+
+Result runPatternSet(const std::vector<std::string> &programs,
+                     const std::vector<std::string> &inputs,
+                     std::vector<bool> &verdicts) {
+    Cicero::PatternSet patterns;
+    for (auto &program : programs) {
+        patterns.add(program.c_str());
+    }
+    patterns.match(""); // Links the set outside of the timings.
+
+    std::vector<std::vector<size_t>> matching;
+    std::vector<double> latencies;
+    Result result = {"set", 0, 0, 0, 0, 0, 0, 0};
+
+    for (auto &input : inputs) {
+        auto start = std::chrono::steady_clock::now();
+        matching.push_back(patterns.match(input));
+        double elapsed = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+        latencies.push_back(elapsed * 1e6);
+        result.seconds += elapsed;
+        result.bytes += input.size() * programs.size();
+        result.matches += programs.size();
+    }
+
+    // In the program by input order of the other modes.
+    for (size_t p = 0; p < programs.size(); p++) {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            verdicts.push_back(std::binary_search(
+                matching[i].begin(), matching[i].end(), p));
+        }
+    }
+
+    result.p50 = percentile(latencies, 0.50);
+    result.p99 = percentile(latencies, 0.99);
+    return result;
+}
+
+void printTable(const std::vector<Result> &results) {
+    printf("%-8s %4s %12s %10s %12s %10s %10s\n", "mode", "W", "matches/s",
+           "MB/s", "cycles/char", "p50 us", "p99 us");
+    for (auto &result : results) {
+        printf("%-8s %4s %12.0f %10.2f ", result.mode.c_str(),
+               result.W > 0 ? std::to_string(result.W).c_str() : "-",
+               result.matches / result.seconds,
+               result.bytes / result.seconds / 1e6);
+        if (result.cycles > 0)
+            printf("%12.2f", result.cycles / result.bytes);
+        else
+            printf("%12s", "-");
+        printf(" %10.2f %10.2f\n", result.p50, result.p99);
+    }
+}
+
+void printJSON(const std::vector<Result> &results, size_t programCount,
+               const std::vector<std::string> &inputs) {
+    size_t bytes = 0;
+    for (auto &input : inputs) {
+        bytes += input.size();
+    }
+
+    printf("{\n  \"corpus\": {\"programs\": %zu, \"inputs\": %zu, "
+           "\"bytes\": %zu},\n  \"results\": [\n",
+           programCount, inputs.size(), bytes);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &result = results[i];
+        printf("    {\"mode\": \"%s\", ", result.mode.c_str());
+        if (result.W > 0)
+            printf("\"W\": %d, ", result.W);
+        else
+            printf("\"W\": null, ");
+        printf("\"matches\": %zu, \"seconds\": %.6f, "
+               "\"matches_per_second\": %.1f, \"bytes_per_second\": %.1f, ",
+               result.matches, result.seconds,
+               result.matches / result.seconds,
+               result.bytes / result.seconds);
+        if (result.cycles > 0)
+            printf("\"cycles_per_char\": %.4f, ", result.cycles / result.bytes);
+        else
+            printf("\"cycles_per_char\": null, ");
+        printf("\"p50_us\": %.3f, \"p99_us\": %.3f}%s\n", result.p50,
+               result.p99, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    bool prefilter = true;
+    bool deduplicate = false;
+    int stride = 10;
+    std::vector<std::string> modes = {"cycle", "pike",     "dfa",
+                                      "bit",   "lockstep", "set"};
+    std::vector<int> windows = {1, 2, 4, 8};
+    const char *usage = " [--json] [--stride N]"
+                        " [--modes cycle,pike,dfa,bit,lockstep,set,jit]"
+                        " [--windows 1,2,4,8] [--no-prefilter] [--dedup]\n";
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool valid = true;
+        if (option == "--json") {
+            json = true;
+        } else if (option == "--no-prefilter") {
+            prefilter = false;
+        } else if (option == "--dedup") {
+            deduplicate = true;
+        } else if (option == "--stride" && i + 1 < argc) {
+            valid = parseNumber("--stride", argv[++i], 1, PROGRAMS_COUNT + 1,
+                                stride);
+        } else if (option == "--modes" && i + 1 < argc) {
+            modes = splitList(argv[++i]);
+        } else if (option == "--windows" && i + 1 < argc) {
+            windows.clear();
+            for (auto &W : splitList(argv[++i])) {
+                windows.push_back(0);
+                valid = valid && parseNumber("--windows", W, 1, MAX_WINDOW,
+                                             windows.back());
+            }
+            valid = valid && !windows.empty();
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << "Usage: " << argv[0] << usage;
+            return -1;
+        }
+    }
+
+    std::ifstream stringsFile(CORPUS_PATH + std::string("strings.txt"));
+    std::vector<std::string> inputs;
+    std::string buffer;
+    while (std::getline(stringsFile, buffer)) {
+        inputs.push_back(buffer);
+    }
+    if (inputs.empty()) {
+        std::cerr << "Unable to read strings.txt from " << CORPUS_PATH
+                  << std::endl;
+        return -1;
+    }
+
+    // Missing programs are skipped, like in test_multi.
+    std::vector<std::string> programs;
+    for (int i = 0; i <= PROGRAMS_COUNT; i += stride) {
+        std::string path =
+            CORPUS_PATH + std::string("programs/") + std::to_string(i);
+        if (std::ifstream(path).good())
+            programs.push_back(path);
+    }
+
+    if (!json)
+        printf("%zu programs x %zu inputs\n\n", programs.size(),
+               inputs.size());
+
+    std::vector<Result> results;
+    std::vector<bool> reference;
+    std::string referenceMode;
+
+    for (auto &mode : modes) {
+        std::vector<Result> modeResults;
+        std::vector<std::vector<bool>> modeVerdicts;
+
+        if (mode == "cycle") {
+            for (int W : windows) {
+                modeVerdicts.emplace_back();
+                modeResults.push_back(
+                    runMode(Cicero::CYCLE_ACCURATE, W, prefilter, deduplicate,
+                            programs, inputs, modeVerdicts.back()));
+            }
+        } else if (mode == "pike" || mode == "dfa" || mode == "bit" ||
+                   mode == "jit") {
+            Cicero::ExecutionMode executionMode =
+                mode == "pike"  ? Cicero::PIKE_VM
+                : mode == "dfa" ? Cicero::LAZY_DFA
+                : mode == "bit" ? Cicero::BIT_PARALLEL
+                                : Cicero::JIT;
+            modeVerdicts.emplace_back();
+            modeResults.push_back(runMode(executionMode, 0, prefilter, false,
+                                          programs, inputs,
+                                          modeVerdicts.back()));
+        } else if (mode == "lockstep") {
+            modeVerdicts.emplace_back();
+            modeResults.push_back(runLockstep(prefilter, programs, inputs,
+                                              modeVerdicts.back()));
+        } else if (mode == "set") {
+            modeVerdicts.emplace_back();
+            modeResults.push_back(
+                runPatternSet(programs, inputs, modeVerdicts.back()));
+        } else {
+            std::cerr << "Unknown execution mode '" << mode << "'.\n";
+            return -1;
+        }
+
+        for (size_t i = 0; i < modeResults.size(); i++) {
+            modeResults[i].mode = mode;
+            if (referenceMode.empty()) {
+                reference = modeVerdicts[i];
+                referenceMode = mode;
+            }
+            if (modeVerdicts[i] != reference) {
+                std::cerr << "Verdicts of mode " << mode
+                          << " differ from those of mode " << referenceMode
+                          << ".\n";
+                return -1;
+            }
+            results.push_back(modeResults[i]);
+        }
+    }
+
+    if (json)
+        printJSON(results, programs.size(), inputs);
+    else
+        printTable(results);
+
+    return 0;
+}
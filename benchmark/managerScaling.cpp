@@ -0,0 +1,113 @@
+// Latency of the Manager on long inputs as the number of engines grows.
+//
+// Long inputs are built by concatenating the protein strings of the test
+// corpus, and matched against a sample of the corpus programs. Latency is
+// reported in simulated clock cycles (what the hardware would take) and in
+// wall-clock time of the simulation.
+//
+// Usage: bench_manager [input length] [program stride] [max engines]
+
+#include "CiceroMulti.h"
+#include "Manager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const int PROGRAMS_COUNT = 1308;
+
+std::vector<std::string> buildLongInputs(size_t length, size_t count) {
+    std::ifstream stringsFile(CORPUS_PATH + std::string("strings.txt"));
+    std::vector<std::string> lines;
+    std::string buffer;
+    while (std::getline(stringsFile, buffer)) {
+        lines.push_back(buffer);
+    }
+
+    std::vector<std::string> inputs;
+    size_t line = 0;
+    for (size_t i = 0; i < count && !lines.empty(); i++) {
+        std::string input;
+        while (input.size() < length) {
+            input += lines[line++ % lines.size()];
+        }
+        input.resize(length);
+        inputs.push_back(input);
+    }
+    return inputs;
+}
+
+int main(int argc, char **argv) {
+    size_t length = argc > 1 ? std::stoul(argv[1]) : 4096;
+    int stride = argc > 2 ? std::stoi(argv[2]) : 100;
+    int maxEngines = argc > 3 ? std::stoi(argv[3]) : 8;
+
+    std::vector<std::string> inputs = buildLongInputs(length, 4);
+    if (inputs.empty()) {
+        std::cerr << "Unable to read strings.txt from " << CORPUS_PATH
+                  << std::endl;
+        return -1;
+    }
+
+    std::vector<Cicero::Instruction> programs;
+    for (int i = 0; i <= PROGRAMS_COUNT; i += stride) {
+        std::string path = CORPUS_PATH + std::string("programs/") +
+                           std::to_string(i);
+        programs.resize(programs.size() + Cicero::INSTR_MEM_SIZE);
+        Cicero::Instruction *program =
+            &programs[programs.size() - Cicero::INSTR_MEM_SIZE];
+
+        // Missing programs are skipped, like in test_multi.
+        if (!Cicero::CiceroMulti::readProgram(path.c_str(), program))
+            programs.resize(programs.size() - Cicero::INSTR_MEM_SIZE);
+    }
+    size_t programCount = programs.size() / Cicero::INSTR_MEM_SIZE;
+
+    printf("%zu programs x %zu inputs of %zu characters\n\n", programCount,
+           inputs.size(), length);
+    printf("%4s %8s %14s %12s %12s %12s\n", "W", "engines", "cycles/match",
+           "cycles/char", "speedup", "ms/match");
+
+    for (int W : {1, 4, 8}) {
+        double baseline = 0;
+        std::vector<bool> reference;
+
+        for (int engines = 1; engines <= maxEngines; engines *= 2) {
+            Cicero::Manager manager(&programs[0], engines, W + 1);
+            std::vector<bool> verdicts;
+            double cycles = 0;
+            double chars = 0;
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t p = 0; p < programCount; p++) {
+                manager.setProgram(&programs[p * Cicero::INSTR_MEM_SIZE]);
+                for (auto &input : inputs) {
+                    verdicts.push_back(manager.match(input));
+                    cycles += manager.getClockCycles();
+                    chars += input.size();
+                }
+            }
+            double elapsed = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+
+            if (engines == 1) {
+                baseline = cycles;
+                reference = verdicts;
+            } else if (verdicts != reference) {
+                std::cerr << "Verdicts with " << engines
+                          << " engines differ from the single engine ones.\n";
+                return -1;
+            }
+
+            printf("%4d %8d %14.0f %12.2f %11.2fx %12.3f\n", W, engines,
+                   cycles / verdicts.size(), cycles / chars,
+                   baseline / cycles, elapsed / verdicts.size());
+        }
+    }
+
+    return 0;
+}
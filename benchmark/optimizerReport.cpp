@@ -0,0 +1,112 @@
+// Instructions and clock cycles ProgramOptimizer saves on the test corpus.
+//
+// Every sampled program is optimized, and every input matched on the cycle
+// accurate engine against both versions, without the prefilter. The report
+// sums what each pass of the optimizer did, the program lengths, and the
+// simulated clock cycles of the matches; the verdicts of the two versions
+// must agree.
+//
+// Usage: bench_optimizer [program stride] [window size]
+
+#include "CiceroMulti.h"
+#include "ProgramOptimizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const int PROGRAMS_COUNT = 1308;
+
+int main(int argc, char **argv) {
+    int stride = argc > 1 ? std::max(1, std::stoi(argv[1])) : 10;
+    int W = argc > 2 ? std::max(1, std::stoi(argv[2])) : 1;
+
+    std::ifstream stringsFile(CORPUS_PATH + std::string("strings.txt"));
+    std::vector<std::string> inputs;
+    std::string buffer;
+    while (std::getline(stringsFile, buffer)) {
+        inputs.push_back(buffer);
+    }
+    if (inputs.empty()) {
+        std::cerr << "Unable to read strings.txt from " << CORPUS_PATH
+                  << std::endl;
+        return -1;
+    }
+
+    Cicero::OptimizerStats total;
+    size_t programCount = 0;
+    size_t literalRunLength = 0;
+    uint64_t cycles = 0;
+    uint64_t optimizedCycles = 0;
+    Cicero::Instruction program[Cicero::INSTR_MEM_SIZE];
+    Cicero::Instruction optimizedProgram[Cicero::INSTR_MEM_SIZE];
+    Cicero::Engine engine(program, W + 1);
+    Cicero::Engine optimizedEngine(optimizedProgram, W + 1);
+
+    for (int i = 0; i <= PROGRAMS_COUNT; i += stride) {
+        std::string path =
+            CORPUS_PATH + std::string("programs/") + std::to_string(i);
+        size_t length;
+        std::fill(program, program + Cicero::INSTR_MEM_SIZE,
+                  Cicero::Instruction());
+        if (!std::ifstream(path).good() ||
+            !Cicero::CiceroMulti::readProgram(path.c_str(), program, false,
+                                              &length))
+            continue;
+
+        Cicero::ProgramOptimizer optimizer(program, length);
+        const Cicero::OptimizerStats &stats = optimizer.getStats();
+        std::fill(optimizedProgram,
+                  optimizedProgram + Cicero::INSTR_MEM_SIZE,
+                  Cicero::Instruction());
+        std::copy(optimizer.getProgram().begin(),
+                  optimizer.getProgram().end(), optimizedProgram);
+
+        programCount++;
+        total.originalLength += stats.originalLength;
+        total.optimizedLength += stats.optimizedLength;
+        total.threadedJumps += stats.threadedJumps;
+        total.inlinedTerminals += stats.inlinedTerminals;
+        total.foldedSplits += stats.foldedSplits;
+        total.removedNops += stats.removedNops;
+        total.removedUnreachable += stats.removedUnreachable;
+        for (auto &run : stats.literalRuns) {
+            total.literalRuns.push_back(run);
+            literalRunLength += run.second;
+        }
+
+        for (auto &input : inputs) {
+            bool verdict = engine.runMultiChar(input);
+            cycles += engine.getClockCycles();
+            if (optimizedEngine.runMultiChar(input) != verdict) {
+                std::cerr << "Program " << i << " optimized does not match "
+                          << input << " as the original does.\n";
+                return -1;
+            }
+            optimizedCycles += optimizedEngine.getClockCycles();
+        }
+    }
+
+    printf("%zu programs x %zu inputs, W = %d\n\n", programCount,
+           inputs.size(), W);
+    printf("threaded jumps       %10zu\n", total.threadedJumps);
+    printf("inlined terminals    %10zu\n", total.inlinedTerminals);
+    printf("folded splits        %10zu\n", total.foldedSplits);
+    printf("removed NOPs         %10zu\n", total.removedNops);
+    printf("removed unreachable  %10zu\n", total.removedUnreachable);
+    printf("literal runs         %10zu (%zu instructions)\n\n",
+           total.literalRuns.size(), literalRunLength);
+    printf("%-20s %12s %12s %8s\n", "", "original", "optimized", "saved");
+    printf("%-20s %12zu %12zu %7.2f%%\n", "instructions",
+           total.originalLength, total.optimizedLength,
+           100.0 * (total.originalLength - total.optimizedLength) /
+               total.originalLength);
+    printf("%-20s %12llu %12llu %7.2f%%\n", "clock cycles",
+           (unsigned long long)cycles, (unsigned long long)optimizedCycles,
+           100.0 * (double(cycles) - double(optimizedCycles)) / cycles);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Export.h"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Cicero {
+
+// Bump allocator for the state of the engines of one worker: memory is
+// carved out of large blocks and only given back all at once, by reset or
+// when the arena goes away, so that the engines allocate their state in a
+// few heap operations and reuse it for every match. An arena is never used
+// by two threads at the same time; each worker owns its own, and so never
+// contends with the others for the heap.
+class CICERO_API Arena {
+  public:
+    static constexpr size_t BLOCK_SIZE = 64 << 10;
+
+    // Destroys what Arena::make built, leaving its memory to the arena.
+    struct Destroy {
+        template <class T> void operator()(T *object) const {
+            object->~T();
+        }
+    };
+    template <class T> using Ptr = std::unique_ptr<T, Destroy>;
+
+  private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> memory;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t current; // Block being carved
+    size_t used;    // Bytes of it handed out
+
+  public:
+    Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Uninitialized memory, valid until the next reset.
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    template <class T> T *allocate(size_t count) {
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+    template <class T, class... Args> Ptr<T> make(Args &&...args) {
+        return Ptr<T>(new (allocate(sizeof(T), alignof(T)))
+                          T(std::forward<Args>(args)...));
+    }
+
+    // Makes all the memory available again, without freeing the blocks.
+    // Nothing allocated before may still be in use.
+    void reset();
+    size_t getCapacity() const;
+};
+
+} // namespace Cicero
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "InputStream.h"
+#include "Instruction.h"
+#include "LazyDFA.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Cicero {
+
+// Bit-parallel NFA (Glushkov style): one bit per state, where the states are
+// the instructions a thread waits on for the current character (MATCH,
+// MATCH_ANY, MATCH_SET, NOT_MATCH, ACCEPT and ACCEPT_PARTIAL), plus a start
+// state. The epsilon closures through SPLIT and JMP are precomputed into
+// tables indexed a byte of the state set at a time, so that each input
+// character costs a few table lookups and word operations:
+//
+//   waiting  = closure(arrived), then the NOT_MATCH letting it through
+//   accept   if waiting holds ACCEPT_PARTIAL, or ACCEPT on '\0'
+//   arrived  = waiting & consumers[character]
+//
+// The verdicts are those of the PikeVM. Programs with more than MAX_STATES
+// states, or that can reach END_WITHOUT_ACCEPTING (whose outcome depends on
+// thread priority, which a set of states does not keep), are matched on a
+// LazyDFA instead.
+class CICERO_API BitParallelNFA {
+  public:
+    static constexpr int WORDS = 2;
+    static constexpr int MAX_STATES = 64 * WORDS;
+
+  private:
+    struct StateSet {
+        uint64_t words[WORDS] = {};
+
+        void set(int state) { words[state / 64] |= uint64_t(1) << state % 64; }
+        bool any() const {
+            uint64_t all = 0;
+            for (int i = 0; i < WORDS; i++)
+                all |= words[i];
+            return all != 0;
+        }
+        StateSet &operator|=(const StateSet &other) {
+            for (int i = 0; i < WORDS; i++)
+                words[i] |= other.words[i];
+            return *this;
+        }
+        StateSet operator&(const StateSet &other) const {
+            StateSet result;
+            for (int i = 0; i < WORDS; i++)
+                result.words[i] = words[i] & other.words[i];
+            return result;
+        }
+        StateSet without(const StateSet &other) const {
+            StateSet result;
+            for (int i = 0; i < WORDS; i++)
+                result.words[i] = words[i] & ~other.words[i];
+            return result;
+        }
+    };
+
+    static constexpr int START = 0;
+
+  public:
+    // What is built from a program, and only read while matching, so that
+    // the NFAs running the same program can share it.
+    struct Tables {
+        bool bitParallel = false;
+        std::vector<unsigned short> statePCs; // [state], PC 0 for START
+        int chunkCount = 0; // Bytes of the state sets in use
+        // Union of the closures of the states set in byte chunk of a state
+        // set: [chunk * 256 + byte].
+        std::vector<StateSet> closures;
+        std::vector<StateSet> consumers;       // [character]
+        std::vector<StateSet> notMatchPassing; // [character]
+        StateSet notMatches;
+        StateSet accepts;
+        StateSet partialAccepts;
+
+        Tables() = default;
+        explicit Tables(const DecodedProgram &program);
+
+        // Bytes held beyond the struct itself.
+        size_t getMemoryUsed() const;
+    };
+
+  private:
+    // Decoded and built here, unless shared ones were given.
+    DecodedProgram decoded;
+    Tables ownTables;
+    const Tables *tables;
+    LazyDFA fallback;
+
+    StateSet closure(const StateSet &arrived) const;
+    ClockResult step(StateSet &arrived, unsigned char currentChar) const;
+
+  public:
+    BitParallelNFA(const Instruction *program);
+    // The decoded program must outlive the matches.
+    BitParallelNFA(const DecodedProgram &program);
+
+    void setProgram(const Instruction *program);
+    void setProgram(const DecodedProgram &program);
+    // With the tables built from program, and the states its fallback
+    // discovered (see LazyDFA::setProgram), both of which must outlive the
+    // matches.
+    void setProgram(const DecodedProgram &program, const Tables &tables,
+                    LazyDFA::Cache &cache);
+    // Of the states the fallback discovers.
+    void setMemoryLimit(size_t memoryLimit);
+    // Whether the program is matched bit-parallel, rather than on the
+    // LazyDFA.
+    bool isBitParallel() const;
+    int getStateCount() const;
+
+    bool match(std::string_view input);
+    bool match(InputStream &input);
+};
+
+} // namespace Cicero
@@ -1,23 +1,62 @@
 #pragma once
 
+#include "Arena.h"
+#include "Const.h"
 #include "CoreOUT.h"
-#include <queue>
-#include <vector>
+#include "SlotMask.h"
+#include <cstddef>
+#include <cstdint>
 
 namespace Cicero {
 
 // Container for all the buffers - permits to instantiate a variable number of
 // buffers.
+//
+// Each buffer is a ring of power-of-two capacity, all of them carved out of
+// one array taken from the arena of the engine. The capacity starts from the
+// number of instructions of the program, enough to hold each of its PCs
+// once, and doubles if a program queues more (the hardware does not
+// deduplicate threads); the old arrays are left to the arena. An occupancy
+// mask tells which buffers are not empty, so that the searches from the
+// window head do not visit every buffer and flushing only clears the mask.
+//
+// Optionally, each buffer also remembers the PCs pushed to it since its
+// window slot was last recycled, and drops the threads pushed again: the
+// same (PC, CC_ID) would only repeat the work, which on patterns like
+// `(a|b)*` grows combinatorially with the input. This departs from the
+// hardware, so it is off unless asked for.
 class Buffers {
   private:
-    std::vector<std::queue<unsigned short>> buffers;
+    static constexpr int VISITED_WORDS = INSTR_MEM_SIZE / 64;
+
+    Arena *arena;
+    unsigned short *storage; // Buffer i at [i * capacity, ...)
+    size_t *starts;          // Match start of each stored thread
+    // Free-running read and write counters, meaningful only for the buffers
+    // set in occupied.
+    unsigned int *heads;
+    unsigned int *tails;
+    SlotMask occupied;
+    bool deduplicate;
+    uint64_t *visited; // Buffer i at [i * VISITED_WORDS, ...)
+    unsigned int capacity;         // Power of two
     int HEAD;
     int size; // 2**W
+
+    void grow();
+
   public:
-    Buffers(int n);
+    // The buffers live in arena, and must not outlive it. programSize is
+    // the number of reachable instructions of the program.
+    Buffers(int n, Arena &arena, unsigned int programSize,
+            bool deduplicate = false);
+    // Makes room for programSize threads per buffer, for a new program.
+    void reserve(unsigned int programSize);
     void flush();
 
-    void slide(unsigned short slide);
+    // The distance slots from HEAD leave the window, to be reused for new
+    // characters: forgets the PCs they were pushed.
+    void slide(unsigned short HEAD, unsigned short distance);
 
     // Expects to be told which is the buffer holding first character of sliding
     // window.
@@ -25,11 +64,17 @@ class Buffers {
     unsigned short getFirstNotEmpty(unsigned short HEAD);
     bool isEmpty(unsigned short CC_ID);
     bool areAllEmpty();
+    unsigned int getOccupancy(unsigned short CC_ID) const;
+    // The buffers that are not empty, kept up to date by every push and pop.
+    const SlotMask &getOccupied() const { return occupied; }
 
     CoreOUT getPC(unsigned short CC_ID);
+    // Start offset of the thread getPC returns, see MatchSpan.
+    size_t getStart(unsigned short CC_ID);
     CoreOUT popPC(unsigned short CC_ID);
 
-    void pushTo(unsigned short CC_ID, unsigned short PC);
+    // Returns false if the thread was dropped as a duplicate.
+    bool pushTo(unsigned short CC_ID, unsigned short PC, size_t start = 0);
 };
 
 } // namespace Cicero
@@ -1,40 +1,281 @@
 #ifndef CICEROMULTI_H
 #define CICEROMULTI_H
 
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <memory>
 #include <queue>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include "Arena.h"
+#include "BitParallelNFA.h"
 #include "Buffers.h"
 #include "Const.h"
 #include "Core.h"
+#include "ClassRewriter.h"
 #include "CoreOUT.h"
+#include "DecodedProgram.h"
 #include "Engine.h"
+#include "Export.h"
+#include "InputStream.h"
 #include "Instruction.h"
+#include "JitVM.h"
+#include "LazyDFA.h"
+#include "LockstepVM.h"
+#include "MatchSpan.h"
+#include "PatternSet.h"
+#include "Probe.h"
+#include "PikeVM.h"
+#include "Prefilter.h"
+#include "ProgramBundle.h"
+#include "ProgramOptimizer.h"
+#include "ThreadPool.h"
+#include "TraceProbe.h"
 
 namespace Cicero {
+
+// Verdicts of a batch, one row per program and one column per input.
+struct BatchResult {
+    size_t programCount = 0;
+    size_t inputCount = 0;
+    std::vector<unsigned char> matches;
+
+    bool isMatch(size_t program, size_t input) const {
+        return matches[program * inputCount + input];
+    }
+};
+
 // Wrapper class that holds and inits all components.
-class CiceroMulti {
+class CICERO_API CiceroMulti {
   private:
     // Components
     Instruction program[INSTR_MEM_SIZE];
 
-    std::unique_ptr<Engine> engine;
+    // A program as the engines run it, see prepare.
+    struct PreparedProgram;
+    // Programs of bundles and batches, each prepared once, by the hash of
+    // their reachable instructions. Kept until the settings they were
+    // prepared with change, or the memory limit is reached. The batch
+    // workers run those of their owner.
+    std::unordered_multimap<uint64_t, std::unique_ptr<PreparedProgram>>
+        prepared;
+    // Those set from each opening of a bundle, by bundle id and index, so
+    // that setting them again, even alternating between bundles, only
+    // points the engines at them.
+    std::unordered_map<uint64_t, std::vector<PreparedProgram *>>
+        bundlePrograms;
+    // The program file last set, prepared anew each time.
+    std::unique_ptr<PreparedProgram> loaded;
+    // What the engines run, null until a program is set.
+    PreparedProgram *current = nullptr;
+    // What the engines run before.
+    DecodedProgram unset;
+    // Which of the DFA states of each program this object discovers: 0,
+    // or 1 + the index of a batch worker.
+    size_t cacheSlot = 0;
+    // The object whose programs this one runs: its owner for a batch
+    // worker, itself otherwise.
+    CiceroMulti *owner = this;
+
+    // Bytes of the prepared programs, and of the DFA states discovered for
+    // them by this object and its workers, as last accounted for (see
+    // setMemoryLimit).
+    size_t memoryLimit = DEFAULT_MEMORY_LIMIT;
+    std::atomic<size_t> memoryUsed{0};
+    // Bytes of the DFA states this object discovered, as accounted for in
+    // the memory used of its owner, and those of the program set.
+    size_t stateMemory = 0;
+    size_t accountedStates = 0;
+
+    // Holds the cycle accurate engines and their match contexts. The
+    // engines of a batch worker are only used by its thread.
+    Arena arena;
+    Arena::Ptr<Engine> engine;
+    std::unique_ptr<PikeVM> pikeVM;
+    // Only built in LAZY_DFA mode.
+    std::unique_ptr<LazyDFA> dfa;
+    // Only built in BIT_PARALLEL mode.
+    std::unique_ptr<BitParallelNFA> bitNFA;
+    // Only built in LOCKSTEP mode.
+    std::unique_ptr<LockstepVM> lockstepVM;
+    // Only built in JIT mode.
+    std::unique_ptr<JitVM> jitVM;
+    // Built on the first match asking for stats.
+    Arena::Ptr<BasicEngine<StatsProbe>> statsEngine;
+    // Used instead of engine in verbose mode, tracing to stdout.
+    Arena::Ptr<BasicEngine<TraceProbe>> traceEngine;
 
     // Settings
+    unsigned short windowSize;
     bool verbose = true;
     bool hasProgram = false;
+    bool usePrefilter;
+    bool deduplicate = false;
+    bool optimize = false;
+    bool characterClasses = false;
+    bool prefiltered = false; // The last match was rejected by the prefilter
+    int streamError = 0;      // See getStreamError
+    ExecutionMode mode;
+
+    // Inputs matched by a batch task, for each program: as many as the
+    // lockstep VM runs together.
+    static constexpr size_t BATCH_BLOCK = LockstepVM::LANES;
+
+    // Inputs passed on to the lockstep VM, and their verdicts, reused
+    // across calls.
+    std::vector<std::string_view> lanes;
+    std::vector<size_t> laneInputs;
+    std::vector<unsigned char> laneResults;
+
+    // Threads and workers of matchBatch, kept from one call to the next.
+    // Each worker is only used by one thread at a time.
+    std::unique_ptr<ThreadPool> pool;
+    unsigned poolThreads = 0; // As asked for, 0 for one per hardware thread
+    std::vector<std::unique_ptr<CiceroMulti>> workers;
+
+    // The prepared program, looked up by its reachable instructions, the
+    // only ones of a bundle program that may be read. A new one is added
+    // unbuilt, and added tells so.
+    PreparedProgram &findPrepared(const Instruction *program, bool &added);
+    // Rewrites, decodes and analyzes the program of prepared as the
+    // settings ask. Only reads this object.
+    void build(PreparedProgram &prepared) const;
+    // Analyzes the program of prepared for its prefilter, only once the
+    // prefilter is in use.
+    void buildPrefilter(PreparedProgram &prepared) const;
+    // Makes room for the DFA states of this object and of its workers.
+    void reserveCaches(PreparedProgram &prepared) const;
+    // Adds the DFA states discovered for the program set since last time to
+    // the memory used by the owner.
+    void accountStates();
+    // Drops the DFA states this object discovered, for every program.
+    void dropStates();
+    // Once over half the memory limit, drops every prepared program but the
+    // one set, with all the DFA states. Only called between batches.
+    void trimPrepared();
+    // Gives each lazy DFA, of this object and of its workers, its share of
+    // the other half.
+    void applyMemoryLimit();
+    PreparedProgram &prepare(const Instruction *program);
+    // Drops the programs prepared with other settings, preparing the one
+    // set again.
+    void dropPrepared();
+    // Prepares program, as read from a file, and points the engines at it.
+    void bindLoaded();
+    // Points every engine at the prepared program.
+    void bindProgram(PreparedProgram &prepared);
+    // matchAll over strings or views.
+    template <class Text>
+    void matchEach(const Text *inputs, size_t count, unsigned char *results);
 
   public:
-    CiceroMulti(unsigned short W = 1, bool dbg = false);
+    static constexpr size_t DEFAULT_MEMORY_LIMIT = size_t(256) << 20;
+
+    CiceroMulti(unsigned short W = 1, bool dbg = false,
+                ExecutionMode mode = CYCLE_ACCURATE);
+    ~CiceroMulti();
+
+    // Reads a program file into program, which must have room for
+    // INSTR_MEM_SIZE instructions, and stores its length in length if given.
+    static bool readProgram(const char *filename, Instruction *program,
+                            bool verbose = false, size_t *length = nullptr);
 
     void setProgram(const char *filename);
+    // Runs a program of the bundle in place, without copying it. The bundle
+    // must stay open while this program is in use. Each program is decoded
+    // and analysed the first time it is set, while the bundle stays open:
+    // setting it again, whatever was set in between, only points the
+    // engines at it, and the lazy DFA resumes the states it discovered.
+    void setProgram(const ProgramBundle &bundle, size_t index);
     bool isProgramSet();
+    // Whether match and scan first check the input against the prefilter of
+    // the program, skipping the engines for inputs it rejects. On by
+    // default, but in the cycle accurate mode, where rejected inputs would
+    // take no clock cycle; matches with stats and streamed matches never
+    // use it. Programs are only analyzed for it while it is on.
+    void setPrefilter(bool enabled);
+    // Whether the cycle accurate engines drop the threads already queued for
+    // the same character (see Buffers). Off by default, as in the hardware.
+    void setDeduplication(bool enabled);
+    // Whether the engines run the programs rewritten by ProgramOptimizer,
+    // with the same verdicts in fewer clock cycles than the hardware would
+    // take on the programs as compiled. Off by default.
+    void setOptimization(bool enabled);
+    // Whether the engines run the programs with their character classes
+    // rewritten into MATCH_SET by ClassRewriter, a software prototype of an
+    // ISA extension. The prefilter and the compiled programs still work on
+    // the programs without it. Off by default.
+    void setCharacterClasses(bool enabled);
+    // Bounds the memory of the prepared programs, and of the DFA states
+    // discovered for them by this object and its batch workers. Each lazy
+    // DFA holds its share of half the limit at most; once the other half is
+    // used, each object drops the states it discovered when it next changes
+    // program, and the next program prepared outside of a batch drops all
+    // the others but the one set. The programs of a batch are all kept
+    // while it runs. DEFAULT_MEMORY_LIMIT by default.
+    void setMemoryLimit(size_t limit);
+
+    // The input is only read during the call, never copied; matching does
+    // not allocate once the engines are warm (the lazy DFA only does when it
+    // discovers states).
+    bool match(std::string_view input);
+    bool match(const uint8_t *input, size_t length) {
+        return match(std::string_view((const char *)input, length));
+    }
+    // Matches every input against the program, storing the verdicts in
+    // results. In LOCKSTEP mode the inputs the prefilter lets through run
+    // together on the lockstep VM, otherwise they are matched one by one.
+    void matchAll(const std::string_view *inputs, size_t count,
+                  unsigned char *results);
+    std::vector<unsigned char>
+    matchAll(const std::vector<std::string> &inputs);
+    std::vector<unsigned char>
+    matchAll(const std::vector<std::string_view> &inputs);
+    // Simulated clock cycles of the last match, in cycle accurate mode, 0 if
+    // the prefilter rejected it.
+    int getClockCycles() const;
+    // Matches on the cycle accurate engine, whatever the execution mode,
+    // counting the events of the simulated hardware into stats.
+    bool match(std::string_view input, EngineStats &stats);
+    // Matches an input of any length as it is read, chunk by chunk (on the
+    // PikeVM in LOCKSTEP and JIT modes). An input that could not be read to
+    // its end does not match, and getStreamError tells why.
+    bool matchStream(InputStream::Reader reader,
+                     size_t chunkSize = InputStream::DEFAULT_CHUNK_SIZE);
+    bool matchStream(int fd);
+    // The errno of the read that failed during the last matchStream, 0 if
+    // the whole input was read.
+    int getStreamError() const;
+
+    // Reports the span of every match in the input, in a single pass, and
+    // returns how many there were. The lazy DFA, the bit-parallel NFA, the
+    // lockstep VM and the compiled programs do not track where matches
+    // start, so in their modes the scan runs on the PikeVM.
+    size_t scan(std::string_view input, const MatchCallback &onMatch);
 
-    bool match(std::string input);
+    // Matches every input against every program file, on a pool of threads
+    // (0 means one per hardware thread) that each own their own engine, with
+    // this object's window size, execution mode and settings. The threads
+    // and their engines are kept for the next call with as many threads,
+    // and each program is decoded and analysed once, for all of them, and
+    // kept with the DFA states they discovered until the settings change.
+    // Programs that cannot be loaded match nothing.
+    BatchResult matchBatch(const std::vector<std::string> &programs,
+                           const std::vector<std::string> &inputs,
+                           unsigned threads = 0);
+    BatchResult matchBatch(const ProgramBundle &bundle,
+                           const std::vector<std::string> &inputs,
+                           unsigned threads = 0);
+    // Programs already in memory, each of INSTR_MEM_SIZE instructions or
+    // from a bundle, which must outlive the call. Null ones match nothing.
+    BatchResult matchBatch(const std::vector<const Instruction *> &programs,
+                           const std::vector<std::string> &inputs,
+                           unsigned threads = 0);
 };
 } // namespace Cicero
 #endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "Instruction.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace Cicero {
+
+// What ClassRewriter did to a program.
+struct ClassRewriterStats {
+    size_t alternations = 0; // SPLIT trees of MATCH rewritten
+    size_t negations = 0;    // NOT_MATCH chains rewritten
+    // Instructions of the trees and chains that no thread reaches any more.
+    size_t removedInstructions = 0;
+    size_t largestClass = 0; // Characters, MATCH_ANY aside
+};
+
+// Rewrites the character classes of a program into MATCH_SET, the extended
+// instruction (see MATCH_SET_FLAG), with a class table:
+//
+//   alternation  a SPLIT whose ways, through SPLIT and JMP only, reach
+//                MATCH and MATCH_ANY that all go on to the same PC, as
+//                compiled from [ILMV]
+//   negation     two or more NOT_MATCH falling through to a MATCH_ANY, as
+//                compiled from [^ILMV]
+//
+// Each becomes a MATCH_SET of the characters it consumes (or a MATCH, or a
+// MATCH_ANY, if that is all they are), followed by a JMP to where its
+// threads went on. Their other instructions are left in place, unreachable,
+// so no PC moves; ProgramOptimizer drops them. A class only entered at its
+// first instruction is rewritten, as its second one is overwritten.
+//
+// One thread runs through the class instead of one per character, for the
+// same verdicts and match spans: the threads it replaces consume the same
+// characters from the same start and meet on the same PC.
+class CICERO_API ClassRewriter {
+  private:
+    std::vector<Instruction> rewritten;
+    std::vector<CharacterClass> classes;
+    ClassRewriterStats stats;
+
+    // [PC], the instructions of the program leading to PC.
+    std::vector<std::vector<unsigned short>> predecessors;
+    // Instructions of the classes rewritten so far.
+    std::vector<bool> rewrittenPCs;
+
+    bool rewriteAlternation(const DecodedProgram &program, unsigned short PC);
+    bool rewriteNegation(const DecodedProgram &program, unsigned short PC);
+    // Writes the class of the instructions members at PC, and a JMP to
+    // next after it.
+    void replace(const std::vector<unsigned short> &members, unsigned short PC,
+                 const CharacterClass &characterClass, unsigned short next);
+
+  public:
+    // program holds INSTR_MEM_SIZE instructions, or comes from a bundle:
+    // only the reachable ones are read.
+    explicit ClassRewriter(const Instruction *program);
+
+    const std::vector<Instruction> &getProgram() const;
+    // Indexed by the data of MATCH_SET, without MATCH_SET_FLAG.
+    const std::vector<CharacterClass> &getClasses() const;
+    const ClassRewriterStats &getStats() const;
+};
+
+} // namespace Cicero
@@ -11,12 +11,29 @@ enum InstrType {
     MATCH_ANY = 5,
     ACCEPT_PARTIAL = 6,
     NOT_MATCH = 7,
+    // Extended opcode space, only known to the software engines: it
+    // prototypes a hardware ISA extension. A MATCH whose data has
+    // MATCH_SET_FLAG set is a MATCH_SET, which consumes any character of
+    // the class its lower bits index in the class table of the program.
+    MATCH_SET = 8,
 };
 
 const int INSTR_MEM_SIZE = 512; // PC is 9bits
 const int BITS_INSTR_TYPE = 3;
 const int BITS_INSTR = 16;
+const unsigned short MATCH_SET_FLAG = 1 << (BITS_INSTR - BITS_INSTR_TYPE - 1);
 
 enum ClockResult { CONTINUE, ACCEPTED, REFUSED };
 
-} // namespace Cicero
\ No newline at end of file
+// How CiceroMulti executes a program: either by simulating the hardware
+// pipeline clock by clock, or functionally, only computing the verdict.
+enum ExecutionMode {
+    CYCLE_ACCURATE = 0,
+    PIKE_VM = 1,
+    LAZY_DFA = 2,
+    BIT_PARALLEL = 3,
+    LOCKSTEP = 4,
+    JIT = 5,
+};
+
+} // namespace Cicero
@@ -3,16 +3,21 @@
 #include "Buffers.h"
 #include "Const.h"
 #include "CoreOUT.h"
+#include "DecodedProgram.h"
 #include "Instruction.h"
+#include "MatchSpan.h"
+#include "Probe.h"
 
-#include <string>
+#include <cstddef>
 
 namespace Cicero {
 
-class Core {
+// The pipeline of one CICERO core, reporting its events to a Probe.
+template <class Probe> class BasicCore {
   private:
-    Instruction
-        *program; // Stage 1 accesses program memory to retrieve instruction.
+    // Stage 1 accesses program memory to retrieve instruction, decoded
+    // when the program was set.
+    const DecodedInstruction *program;
 
     // Signals (as seen from HDL)
     bool accept;
@@ -20,17 +25,29 @@ class Core {
     bool running;
 
     // Inter-phase registers
-    Instruction *pipelineRegister12;
-    Instruction *pipelineRegister23;
+    const DecodedInstruction *pipelineRegister12;
+    const DecodedInstruction *pipelineRegister23;
     CoreOUT outStage1;
     CoreOUT outStage2;
+    size_t startStage1;
+    size_t startStage2;
 
-    // settings
-    bool verbose;
+    // Span of the last accepting thread. When onMatch is set, accepting
+    // threads are reported to it and the run goes on without them.
+    MatchSpan match;
+    unsigned short matchPC; // Of the instruction that accepted it
+    const MatchCallback *onMatch;
+
+    Probe probe;
 
   public:
-    Core(Instruction *p, bool dbg = false);
+    BasicCore(const DecodedInstruction *p);
     void reset();
+    void setProgram(const DecodedInstruction *p);
+    void setMatchCallback(const MatchCallback *callback);
+    MatchSpan getMatch() const;
+    unsigned short getMatchPC() const { return matchPC; }
+    Probe &getProbe() { return probe; }
 
     bool isAccepted() const;
     bool isValid() const;
@@ -39,21 +56,30 @@ class Core {
     bool isStage2Ready();
     bool isStage3Ready();
 
-    Instruction *getPipelineRegister12();
-    Instruction *getPipelineRegister23();
+    const DecodedInstruction *getPipelineRegister12();
+    const DecodedInstruction *getPipelineRegister23();
     CoreOUT getOutStage1();
     CoreOUT getOutStage2();
 
     void stage1Stall();
-    void stage1(CoreOUT bufferOUT);
+    void stage1(CoreOUT bufferOUT, size_t start);
 
     void stage2Stall();
-    CoreOUT stage2(CoreOUT sCO12, Instruction *stage12, char currentChar);
+    CoreOUT stage2(CoreOUT sCO12, const DecodedInstruction *stage12,
+                   char currentChar);
 
-    CoreOUT stage3(CoreOUT sCO23, Instruction *stage23);
-    ClockResult runClock(std::string input, int currentWindowIndex,
-                         int currentBufferIndex, int windowSize,
-                         Buffers *buffers);
+    CoreOUT stage3(CoreOUT sCO23, const DecodedInstruction *stage23);
+    // window points to the first character of the sliding window, which is
+    // at windowPosition in the input, and of which windowLength belong to
+    // the input; the one after them reads as '\0', whether or not window
+    // holds it. Threads spawned by
+    // SPLIT go to station when given, to buffers otherwise.
+    ClockResult runClock(const char *window, size_t windowLength,
+                         size_t windowPosition, int currentBufferIndex,
+                         int windowSize,
+                         Buffers *buffers, Buffers *station = nullptr);
 };
 
+using Core = BasicCore<NullProbe>;
+
 } // namespace Cicero
@@ -1,21 +1,27 @@
 #pragma once
 
+#include <cstdint>
+
 namespace Cicero {
 
 // Models the output of the Core, which is the new PC plus the bit indicating
 // whether the returned instruction refers to the active character or not.
+// Both are packed into a single 32 bit word, the PC in the low half, so that
+// a CoreOUT travels through the pipeline in one register.
 class CoreOUT {
   private:
-    unsigned short PC;
-    unsigned short CC_ID;
+    uint32_t word;
 
   public:
-    CoreOUT();
-    CoreOUT(unsigned short PC);
-    CoreOUT(unsigned short PC, unsigned short CC_ID);
+    constexpr CoreOUT() : word(0) {}
+    constexpr CoreOUT(unsigned short PC, unsigned short CC_ID = 0)
+        : word(uint32_t(PC) | uint32_t(CC_ID) << 16) {}
 
-    unsigned short getPC();
-    unsigned short getCC_ID();
+    constexpr unsigned short getPC() const { return word & 0xffff; }
+    constexpr unsigned short getCC_ID() const { return word >> 16; }
 };
 
+static_assert(sizeof(CoreOUT) == sizeof(uint32_t),
+              "CoreOUT must fit in a 32 bit word");
+
 } // namespace Cicero
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Const.h"
+#include "Export.h"
+#include "Instruction.h"
+
+#include <bitset>
+#include <vector>
+
+namespace Cicero {
+
+// One bit per character.
+using CharacterClass = std::bitset<256>;
+
+// An instruction expanded when the program is set into everything the
+// engines need to execute it, so that nothing is decoded while matching.
+// Each one fills a cache line.
+struct alignas(64) DecodedInstruction {
+    // Characters on which a thread goes on to the next PC: the character of
+    // MATCH, any but that of NOT_MATCH, all of them for MATCH_ANY and the
+    // class of MATCH_SET. Empty for the other types.
+    CharacterClass accepted;
+    Instruction instruction; // As loaded, for the probes
+    unsigned char type;
+    unsigned char character; // What MATCH and NOT_MATCH compare against
+    unsigned short data;
+    unsigned short next;   // PC + 1
+    unsigned short target; // Where SPLIT and JMP lead, data otherwise
+
+    DecodedInstruction() : DecodedInstruction(Instruction(), 0) {}
+    DecodedInstruction(Instruction instruction, unsigned short PC);
+};
+
+// A program decoded once, when it is set, and shared by the engines running
+// it (which must not outlive it). Only the instructions reachable from PC 0
+// are read, since a program of a bundle ends where they do; the others
+// decode as ACCEPT, like an empty program memory. So does a null program.
+// The classes of MATCH_SET are copied from the class table of the program;
+// without one, or past its end, a MATCH_SET matches nothing.
+class CICERO_API DecodedProgram {
+  private:
+    std::vector<DecodedInstruction> instructions;
+    std::vector<bool> reachable;
+    unsigned short reachableCount = 0;
+
+  public:
+    DecodedProgram() = default;
+    explicit DecodedProgram(const Instruction *program,
+                            const std::vector<CharacterClass> &classes = {});
+
+    void decode(const Instruction *program,
+                const std::vector<CharacterClass> &classes = {});
+
+    // INSTR_MEM_SIZE instructions, null until a program is decoded.
+    const DecodedInstruction *data() const {
+        return instructions.empty() ? nullptr : instructions.data();
+    }
+    const DecodedInstruction &operator[](unsigned short PC) const {
+        return instructions[PC];
+    }
+    bool isReachable(unsigned short PC) const { return reachable[PC]; }
+    // How many instructions a thread can reach, 0 without a program.
+    unsigned short getReachableCount() const { return reachableCount; }
+};
+
+} // namespace Cicero
@@ -1,47 +1,130 @@
 #pragma once
 
+#include "Arena.h"
 #include "Buffers.h"
 #include "Core.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "InputStream.h"
 #include "Instruction.h"
+#include "MatchSpan.h"
+#include "Probe.h"
+#include "SlotMask.h"
+#include <cstddef>
 #include <memory>
-#include <string>
+#include <string_view>
 #include <vector>
 
 namespace Cicero {
 
-class Engine {
-  private:
-    // Components
-    std::unique_ptr<Buffers> buffers;
-    std::unique_ptr<Core> core;
+// What a match of a BasicEngine changes: the pipeline, the buffers and the
+// sliding window over the input. It is allocated once, in the arena of the
+// engine, and reused by every match.
+template <class Probe> struct MatchContext {
+    BasicCore<Probe> core;
+    Buffers buffers;
 
-    std::string input;
-    int currentClockCycle;
+    // The input is either borrowed for the match, or pulled from a stream.
+    std::string_view input;
+    InputStream *stream = nullptr;
+    int currentClockCycle = 0;
 
     // Engine signal
-    unsigned short currentWindowIndex;
+    size_t currentWindowIndex = 0;
 
-    unsigned short currentBufferIndex;
-    // Bitmap containing which buffers are ready to execute some threads
-    std::vector<bool> CCIDBitmap;
-    unsigned short windowSize;
+    // Resident characters of the sliding window, see Core::runClock.
+    const char *window = nullptr;
+    size_t windowLength = 0;
+    bool isPastEnd = false;
 
-    // settings
-    bool verbose;
+    unsigned short currentBufferIndex = 0;
+    // Bitmap containing which window slots still hold some thread, in the
+    // buffers or in the pipeline.
+    SlotMask CCIDBitmap;
+
+    MatchContext(const DecodedProgram &program, unsigned short W,
+                 bool deduplicate, Arena &arena);
+};
+
+// Cycle accurate simulation of a CICERO engine: a core and its buffers,
+// with the sliding window over the input. The Probe observes the simulated
+// events (see Probe.h); Engine does not observe anything.
+//
+// The engine itself only holds what does not change while matching, its
+// program and window size; the rest is in its MatchContext.
+template <class Probe> class CICERO_API BasicEngine {
+  private:
+    // The program, when the engine was given its instructions rather than
+    // a shared decoded program.
+    DecodedProgram decoded;
+    // The arena of the context, when the engine was not given one.
+    std::unique_ptr<Arena> ownArena;
+    Arena::Ptr<MatchContext<Probe>> context;
+    unsigned short windowSize;
 
     ClockResult runClock();
+    bool run();
+
+    void restart(bool loadFirstThread);
+    void loadWindow();
 
     void updateBitmap();
     unsigned short checkBitmap();
 
   public:
-    Engine(Instruction *program, unsigned short W, bool dbg = false);
+    // With deduplicate, the buffers drop the threads already pushed for the
+    // same character (see Buffers), unlike the hardware. Engines given an
+    // arena allocate their context from it, and must not outlive it; the
+    // others own an arena of their own.
+    BasicEngine(const Instruction *program, unsigned short W,
+                bool deduplicate = false, Arena *arena = nullptr);
+    // Runs a program decoded once for several engines, which must outlive
+    // the matches.
+    BasicEngine(const DecodedProgram &program, unsigned short W,
+                bool deduplicate = false, Arena *arena = nullptr);
+
+    void setProgram(const Instruction *program);
+    void setProgram(const DecodedProgram &program);
 
     static int mod(int k, int n);
 
-    void reset(std::string newInput);
+    // Without loadFirstThread the engine starts with no thread, waiting to
+    // be given some through pushThread.
+    // The input is not copied, it must outlive the match.
+    void reset(std::string_view newInput, bool loadFirstThread = true);
+    void reset(InputStream &newStream, bool loadFirstThread = true);
+
+    bool runMultiChar(std::string_view _input);
+    // Matches an input read chunk by chunk, keeping only the characters of
+    // the sliding window resident.
+    bool runStream(InputStream &_stream);
+
+    // Runs over the whole input, reporting the span of every accepting
+    // thread instead of stopping at the first one, and returns how many were
+    // reported. The spans are those the PikeVM reports: threads reaching
+    // the same accepting instruction at the same end are reported once,
+    // with the latest start, when the window has left that end behind.
+    size_t scan(std::string_view _input, const MatchCallback &onMatch);
 
-    bool runMultiChar(std::string _input);
+    // Span of the thread that made the last match accept.
+    MatchSpan getMatch() const;
+
+    int getClockCycles() const;
+    Probe &getProbe() { return context->core.getProbe(); }
+
+    // Cooperative execution, where a Manager owns the sliding window and
+    // shares threads among several engines.
+    ClockResult runCoreClock(size_t windowIndex, unsigned short bufferIndex,
+                             Buffers *station);
+    bool hasInstructionReady(unsigned short bufferIndex);
+    void pushThread(CoreOUT thread, size_t start);
+    // Whether a thread for CC_ID sits in the buffers or in the pipeline.
+    bool isSlotOccupied(unsigned short CC_ID);
+    // Sets in slots the CC_IDs for which isSlotOccupied holds.
+    void markOccupiedSlots(SlotMask &slots);
+    bool isIdle();
 };
 
+using Engine = BasicEngine<NullProbe>;
+
 } // namespace Cicero
@@ -0,0 +1,10 @@
+#pragma once
+
+// The library is built with its symbols hidden (see CMakeLists.txt), so that
+// calls between its own functions are bound and inlined at link time. What
+// its users may call is marked CICERO_API.
+#if defined(__GNUC__)
+#define CICERO_API __attribute__((visibility("default")))
+#else
+#define CICERO_API
+#endif
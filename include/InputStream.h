@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Export.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Cicero {
+
+// Input that arrives in chunks, pulled from a reader on demand. Only the
+// characters from the last released position onwards are kept resident, so
+// that inputs of any length are matched in memory bounded by the chunk size
+// (or by what the engine asks to see at once, if larger).
+//
+// Positions are absolute offsets from the start of the input.
+class CICERO_API InputStream {
+  public:
+    // Fills buffer with up to capacity characters and returns how many it
+    // wrote; 0 marks the end of the input, READ_ERROR a failure to read it
+    // (with errno set).
+    using Reader = std::function<size_t(char *buffer, size_t capacity)>;
+
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 << 10;
+    static constexpr size_t READ_ERROR = SIZE_MAX;
+
+  private:
+    Reader reader;
+    std::vector<char> buffer;
+    size_t bufferStart;  // Position of buffer[0]
+    size_t buffered;     // Characters held in buffer
+    size_t releasedUpTo; // Characters before it can be dropped
+    size_t chunkSize;
+    bool ended;
+    int error; // errno of the failed read, 0 if none
+
+    void readChunk();
+
+  public:
+    InputStream(Reader reader, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    // Reads from a file descriptor until end of file or a read error.
+    static Reader fromFileDescriptor(int fd);
+
+    // Makes the count characters from position resident, unless the input
+    // ends first, and returns how many characters from position are
+    // resident (0 if the input ends at or before position).
+    size_t request(size_t position, size_t count);
+
+    // Points to the character at position, which must be resident.
+    const char *at(size_t position) const;
+
+    // Characters before position will not be requested anymore.
+    void release(size_t position);
+
+    // Whether the input ends before position, the position right after the
+    // last character being its '\0' terminator.
+    bool isPastEnd(size_t position);
+
+    // The errno of the read that failed, which ended the input early, or 0
+    // if none did.
+    int getError() const;
+};
+
+} // namespace Cicero
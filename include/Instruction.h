@@ -1,22 +1,33 @@
 #pragma once
 
+#include "Const.h"
+#include "Export.h"
+
 namespace Cicero {
 
 // Wrapper around the 16bit instruction for easy retrieval of type, data and
-// easy printing.
-class Instruction {
+// easy printing. Decoding is inline, as the engines do it on every step.
+class CICERO_API Instruction {
   private:
     unsigned short instr;
 
   public:
-    Instruction();
+    constexpr Instruction() : instr(0) {}
+    constexpr Instruction(unsigned short instruction) : instr(instruction) {}
 
-    Instruction(unsigned short instruction);
-    unsigned short getType();
-    unsigned short getData();
+    constexpr unsigned short getType() const {
+        return instr >> (BITS_INSTR - BITS_INSTR_TYPE);
+    }
+    constexpr unsigned short getData() const {
+        return instr & ((1 << (BITS_INSTR - BITS_INSTR_TYPE)) - 1);
+    }
+    // MATCH_SET is encoded as a MATCH, see MATCH_SET_FLAG.
+    constexpr bool isMatchSet() const {
+        return getType() == MATCH && (getData() & MATCH_SET_FLAG) != 0;
+    }
 
-    void printType(int PC);
-    void print(int pc);
+    void printType(int PC) const;
+    void print(int pc) const;
 };
 
 } // namespace Cicero
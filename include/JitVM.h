@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "Instruction.h"
+#include "PikeVM.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Cicero {
+
+// Functional executor that runs a program compiled to native code. The
+// program is translated into a C++ function, a Pike VM specialized for it:
+// every instruction becomes a labelled block, JMP and SPLIT direct branches
+// to the blocks of their targets, and MATCH a compare against its character
+// as an immediate. The function is compiled into a shared object with the
+// C++ compiler the library was built with (or $CICERO_JIT_CXX) and loaded
+// with dlopen.
+//
+// Shared objects are cached on disk by the hash of the program, in
+// $CICERO_JIT_CACHE (by default cicero-jit in $XDG_CACHE_HOME or
+// ~/.cache), so each program is only compiled once across runs; within a
+// process, each one is only loaded once, whichever JitVM asks for it first.
+// The cache is only used if it is a directory of the user that no one else
+// can write to. A program that cannot be compiled is matched on the PikeVM.
+//
+// The verdicts are those of the PikeVM.
+class CICERO_API JitVM {
+  public:
+    using MatchFunction = int (*)(const char *input, size_t size);
+
+  private:
+    PikeVM fallback;
+    // Null when matching on the fallback.
+    MatchFunction compiled;
+
+    static MatchFunction compile(const Instruction *program, uint64_t hash);
+
+  public:
+    // Nothing is compiled before a program is set.
+    JitVM(const Instruction *program);
+
+    // Compiles program, or loads it from the cache.
+    void setProgram(const Instruction *program);
+    // Runs what load returned for a program, on the PikeVM over the decoded
+    // program (which must outlive the matches) if it is null.
+    void setProgram(const DecodedProgram &program, MatchFunction compiled);
+    // Whether the program runs as native code, rather than on the PikeVM.
+    bool isCompiled() const;
+
+    bool match(std::string_view input);
+
+    // The program compiled, or loaded from the cache; null if it cannot be
+    // compiled.
+    static MatchFunction load(const Instruction *program);
+    // The hash the compiled program is cached under, and its source.
+    static uint64_t hash(const Instruction *program);
+    static std::string generateSource(const Instruction *program);
+};
+
+} // namespace Cicero
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "Instruction.h"
+#include "PikeVM.h"
+
+#include <cstddef>
+#include <map>
+#include <string_view>
+#include <vector>
+
+namespace Cicero {
+
+// DFA built on demand by subset construction over the program NFA. A state
+// is the ordered list of PCs waiting for the next character, and a
+// transition is the PikeVM step over one character, so the verdicts are the
+// same as the PikeVM's. Transitions are cached in a 256-wide table as they
+// are discovered: once warm, each character costs a single lookup.
+//
+// The cache survives across inputs and is cleared when the program changes,
+// unless the program comes with a cache of its own. When a new state would
+// exceed the memory limit, the cache is cleared, as RE2 does, and the DFA
+// goes on from that state alone; only when not even that fits is the input
+// finished on the PikeVM.
+class CICERO_API LazyDFA {
+  public:
+    // The states discovered for one program.
+    struct Cache {
+        std::vector<int> transitions; // [state * 256 + character]
+        std::vector<std::vector<unsigned short>> states;
+        std::map<std::vector<unsigned short>, int> stateIndex;
+        size_t memoryUsed = 0;
+    };
+
+  private:
+    // Table entries that are not state indices.
+    static constexpr int UNKNOWN = -1;
+    static constexpr int ACCEPTING = -2;
+    static constexpr int REFUSING = -3;
+    static constexpr int CACHE_FULL = -4; // Returned, never stored.
+
+    PikeVM nfa;
+
+    // Used unless the program came with a cache.
+    Cache ownCache;
+    Cache *cache;
+    std::vector<unsigned short> nextEntries;
+
+    size_t memoryLimit;
+
+    int addState(const std::vector<unsigned short> &entries);
+    int computeTransition(int state, unsigned char currentChar);
+    // Clears the cache, which is full, and adds back the start state and the
+    // state of nextEntries, whose index it returns (CACHE_FULL if it does
+    // not fit).
+    int flush();
+
+  public:
+    static constexpr size_t DEFAULT_MEMORY_LIMIT = 8 << 20;
+
+    LazyDFA(const Instruction *program,
+            size_t memoryLimit = DEFAULT_MEMORY_LIMIT);
+    // The decoded program must outlive the matches.
+    LazyDFA(const DecodedProgram &program,
+            size_t memoryLimit = DEFAULT_MEMORY_LIMIT);
+
+    // Drops every cached state. Must be called when the program changes.
+    void reset();
+    // Applies to the states added from then on: a cache holding more is
+    // only flushed when the next state does not fit.
+    void setMemoryLimit(size_t memoryLimit);
+    void setProgram(const Instruction *program);
+    void setProgram(const DecodedProgram &program);
+    // Resumes the states of cache, which were discovered for this program
+    // (with the same memory limit), if any. The cache must outlive the
+    // matches, and only be used by one LazyDFA at a time.
+    void setProgram(const DecodedProgram &program, Cache &cache);
+
+    bool match(std::string_view input);
+    bool match(InputStream &input);
+
+    size_t getStateCount() const;
+    size_t getMemoryUsed() const;
+};
+
+} // namespace Cicero
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "Instruction.h"
+#include "PikeVM.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Cicero {
+
+// Functional executor for one program over many inputs at once: up to LANES
+// inputs advance together, one character per step, through the same thread
+// lists. The thread state is kept per PC rather than per input, as the mask
+// of the lanes with a thread there, so that each instruction is followed
+// once per step for all the lanes. A MATCH keeps the lanes whose current
+// character is its own, found by comparing the characters of all the lanes
+// at once; a MATCH_SET looks the character of each lane up in its class.
+// Lanes that accept, run out of threads or move past their '\0' are masked
+// off, and the batch ends when none is left.
+//
+// The verdicts are those of the PikeVM. Programs that can reach
+// END_WITHOUT_ACCEPTING (whose outcome depends on thread priority, which a
+// lane mask does not keep) are matched on the PikeVM, one input at a time.
+class CICERO_API LockstepVM {
+  public:
+    static constexpr int LANES = 64;
+    using LaneMask = uint64_t;
+
+  private:
+    // Decoded here, unless a shared decoded program was given.
+    DecodedProgram decoded;
+    const DecodedInstruction *program;
+    PikeVM fallback;
+    bool lockstep;
+
+    // [PC], the lanes whose thread arrives at PC for the current character
+    // and for the next one, and those already followed through PC.
+    std::vector<LaneMask> arrived;
+    std::vector<LaneMask> nextArrived;
+    std::vector<LaneMask> followed;
+    // PCs with lanes in the masks above, so that only they are visited and
+    // cleared.
+    std::vector<unsigned short> arrivedPCs;
+    std::vector<unsigned short> nextPCs;
+    std::vector<unsigned short> followedPCs;
+    // Lanes still to follow from a PC, while following the closure.
+    std::vector<std::pair<unsigned short, LaneMask>> stack;
+
+    // Current character of each lane, and the lanes it is equal to for the
+    // characters compared so far in this step.
+    alignas(64) unsigned char characters[LANES];
+    LaneMask equal[256];
+    unsigned int equalStep[256];
+    unsigned int step;
+
+    void nextStep();
+    LaneMask lanesEqualTo(unsigned char character);
+    // Those of lanes whose current character is in the class.
+    LaneMask lanesIn(const CharacterClass &characterClass, LaneMask lanes);
+    void queue(unsigned short PC, LaneMask lanes);
+    // Follows the closure of the arrived lanes for the current characters,
+    // queueing those that consume them in nextArrived. Returns the lanes
+    // that accept.
+    LaneMask advance();
+
+  public:
+    LockstepVM(const Instruction *program);
+    // The decoded program must outlive the matches.
+    LockstepVM(const DecodedProgram &program);
+
+    void setProgram(const Instruction *program);
+    void setProgram(const DecodedProgram &program);
+    // Whether the program is matched in lockstep, rather than on the PikeVM.
+    bool isLockstep() const;
+
+    // Stores in results[i] whether inputs[i] matches, LANES inputs at a time.
+    void match(const std::string_view *inputs, size_t count,
+               unsigned char *results);
+    bool match(std::string_view input);
+};
+
+} // namespace Cicero
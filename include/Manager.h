@@ -1,17 +1,56 @@
 #pragma once
 
+#include "Arena.h"
+#include "Buffers.h"
+#include "DecodedProgram.h"
 #include "Engine.h"
+#include "Export.h"
+#include "SlotMask.h"
+
+#include <string_view>
+#include <vector>
 
 namespace Cicero {
 
-class Manager {
+// Runs several engines co-operatively on the same input. The Manager owns
+// the sliding window, shared by all the engines. Threads spawned by SPLIT
+// are not kept by the engine that executed it, but go to a reservation
+// station (one FIFO per window slot); at the start of every clock cycle,
+// each engine with no instruction ready takes the station thread closest to
+// the head of the window. The window slides once no engine and no station
+// slot holds a thread for its first character.
+class CICERO_API Manager {
   private:
+    // Decoded once for all the engines.
+    DecodedProgram decoded;
+    // Holds the match contexts of the engines and the station.
+    Arena arena;
     std::vector<Engine> engines;
+    Buffers station;
+
+    std::string_view input;
+    int currentClockCycle;
+    size_t currentWindowIndex;
+    unsigned short currentBufferIndex;
+    unsigned short windowSize;
+
+    // Bitmap containing which window slots still hold some thread
+    SlotMask CCIDBitmap;
+
+    void dispatch();
+    void updateBitmap();
+    unsigned short checkBitmap();
 
   public:
-    Manager(Instruction *program, int engineCount, int windowSize);
+    // windowSize is the number of buffers per engine (W + 1), as for Engine.
+    Manager(const Instruction *program, int engineCount, int windowSize);
+
+    void setProgram(const Instruction *program);
+
+    // True on the first ACCEPT reached by any engine.
+    bool match(std::string_view input);
 
-    bool match(std::string input);
+    int getClockCycles() const;
 };
 
-} // namespace Cicero
\ No newline at end of file
+} // namespace Cicero
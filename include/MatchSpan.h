@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace Cicero {
+
+// Characters [start, end) of the input recognized by an accepting thread.
+//
+// The start of a thread is the position at which it last executed PC 0: the
+// compiler puts the `.*` loop that skips input in front of the pattern there,
+// so a thread leaving the loop carries the position its pattern began at.
+// The end is the position of the ACCEPT_PARTIAL, which does not consume, or
+// the end of the input for ACCEPT.
+struct MatchSpan {
+    size_t start;
+    size_t end;
+};
+
+using MatchCallback = std::function<void(const MatchSpan &)>;
+
+} // namespace Cicero
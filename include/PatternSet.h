@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "Instruction.h"
+#include "ThreadList.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Cicero {
+
+// Many programs linked into a single instruction space, so that an input is
+// read once to find which of them match it.
+//
+// Linked instructions have the same types as Instruction, MATCH_SET decoded,
+// and a 28 bit data field: SPLIT and JMP targets are relocated into the
+// combined space, which is not bounded by INSTR_MEM_SIZE, MATCH_SET indexes
+// the classes of all the patterns, and ACCEPT and ACCEPT_PARTIAL carry the
+// tag of the pattern they belong to. The set runs the ThreadList of the
+// PikeVM over all the patterns at once; a pattern stops running once it has
+// matched.
+//
+// Most programs start with a `.*` loop (a MATCH_ANY jumping back to PC 0),
+// so that their entry is live at every position. For those, what the entry
+// leads to on each character is computed once when the set is linked, and
+// the loops themselves are never run.
+//
+// Only the verdicts are computed. END_WITHOUT_ACCEPTING stops its pattern
+// without a match, regardless of the priority of the threads.
+class CICERO_API PatternSet {
+  private:
+    class LinkedInstruction {
+      private:
+        uint32_t instr;
+
+      public:
+        static constexpr int BITS_DATA = 28;
+
+        LinkedInstruction(unsigned short type, uint32_t data)
+            : instr(uint32_t(type) << BITS_DATA | data) {}
+        unsigned short getType() const { return instr >> BITS_DATA; }
+        uint32_t getData() const { return instr & ((1u << BITS_DATA) - 1); }
+    };
+
+    static constexpr uint32_t NO_PC = ~uint32_t(0);
+
+    // The linked instructions, as the ThreadList reads them.
+    struct Instructions {
+        using Address = uint32_t;
+        const std::vector<LinkedInstruction> &program;
+        const std::vector<CharacterClass> &classes;
+
+        size_t size() const { return program.size(); }
+        unsigned char getType(Address PC) const {
+            return program[PC].getType();
+        }
+        Address getNext(Address PC) const { return PC + 1; }
+        Address getTarget(Address PC) const { return program[PC].getData(); }
+        bool isAccepted(Address PC, char currentChar) const;
+    };
+    struct Verdicts;
+
+    std::vector<LinkedInstruction> program;
+    std::vector<CharacterClass> classes; // Of MATCH_SET
+    std::vector<uint32_t> owner;   // Pattern of each PC
+    std::vector<uint32_t> entries; // Entry PC of each pattern
+    // Entry PCs run as ordinary threads, from the start of the input only.
+    std::vector<uint32_t> anchoredEntries;
+
+    // For the patterns with a `.*` loop, PCs their entries lead to after
+    // consuming each character, and patterns they accept on it.
+    std::vector<std::vector<uint32_t>> startNext;    // [character]
+    std::vector<std::vector<uint32_t>> startAccepts; // [character]
+    size_t loopCount;
+    bool linked;
+
+    // Matching state, as in PikeVM.
+    ThreadList<Instructions> threads;
+    std::vector<uint32_t> current;
+    std::vector<uint32_t> next;
+    // Patterns whose threads accepted or stopped on the current character.
+    std::vector<uint32_t> accepts;
+    std::vector<uint32_t> stops;
+
+    enum PatternState : unsigned char { RUNNING, MATCHED, STOPPED };
+    std::vector<PatternState> states;
+    size_t running;
+
+    uint32_t findLoop(uint32_t entry) const;
+    void link();
+    void finish(uint32_t pattern, PatternState state);
+    void addThread(uint32_t PC, char currentChar);
+    void consume(char currentChar);
+
+  public:
+    PatternSet();
+
+    // Appends a program, tagged with the number of patterns added before it,
+    // with the class table of its MATCH_SET (see ClassRewriter). Malformed
+    // programs are rejected, without using a tag.
+    bool add(const Instruction *program, size_t length,
+             const std::vector<CharacterClass> &classes = {});
+    bool add(const char *filename);
+
+    size_t getPatternCount() const;
+    size_t getInstructionCount() const;
+
+    // Tags of the patterns that match input, in increasing order.
+    std::vector<size_t> match(std::string_view input);
+};
+
+} // namespace Cicero
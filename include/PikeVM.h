@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "InputStream.h"
+#include "Instruction.h"
+#include "MatchSpan.h"
+#include "ThreadList.h"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace Cicero {
+
+// Functional executor: runs the same program as the Engine, but as a
+// thread-list NFA (Pike VM) that advances one input character per step,
+// without modelling the pipeline stages, the buffers or the sliding window.
+// It only computes the match verdict.
+//
+// The character semantics follow Core::stage2: the character after the end
+// of the input is '\0' (the input itself need not be terminated), ACCEPT
+// only succeeds on '\0', and threads that move past it are dropped.
+// Duplicate (PC, character) threads are executed once. END_WITHOUT_ACCEPTING
+// refuses as soon as a thread reaches it in priority order, whereas in the
+// Engine the winner depends on pipeline timing.
+//
+// Threads also carry the start of their match (see MatchSpan). When threads
+// from different starts meet on a PC, the one first in priority order is
+// kept: with the `.*` loop in front of the pattern, the latest start.
+class CICERO_API PikeVM {
+  private:
+    // The decoded instructions, as the ThreadList reads them.
+    struct Instructions {
+        using Address = unsigned short;
+        const DecodedInstruction *program;
+
+        size_t size() const { return INSTR_MEM_SIZE; }
+        unsigned char getType(Address PC) const { return program[PC].type; }
+        Address getNext(Address PC) const { return program[PC].next; }
+        Address getTarget(Address PC) const { return program[PC].target; }
+        bool isAccepted(Address PC, char currentChar) const {
+            return program[PC].accepted[(unsigned char)currentChar];
+        }
+    };
+
+    // Decoded here, unless a shared decoded program was given.
+    DecodedProgram decoded;
+    const DecodedInstruction *program;
+
+    ThreadList<Instructions> threads;
+    std::vector<unsigned short> entries;
+    std::vector<unsigned short> nextEntries;
+    // Match starts, parallel to the vectors above.
+    std::vector<size_t> entryStarts;
+    std::vector<size_t> nextStarts;
+
+    // When set, accepting threads are reported to it and dropped instead of
+    // ending the match.
+    const MatchCallback *onMatch;
+    // step, with the match starts of entryPCs (0 if null) for a character
+    // at position. Those of next are left in nextStarts.
+    ClockResult advance(const std::vector<unsigned short> &entryPCs,
+                        const size_t *entryPCStarts, char currentChar,
+                        size_t position, std::vector<unsigned short> &next);
+
+  public:
+    PikeVM(const Instruction *program);
+    // The decoded program must outlive the matches.
+    PikeVM(const DecodedProgram &program);
+
+    void setProgram(const Instruction *program);
+    void setProgram(const DecodedProgram &program);
+
+    // Consumes currentChar: follows the closure of the entry PCs (in
+    // priority order) and stores the PCs waiting for the next character in
+    // next. Returns ACCEPTED or REFUSED if the closure reaches a verdict.
+    ClockResult step(const std::vector<unsigned short> &entryPCs,
+                     char currentChar, std::vector<unsigned short> &next);
+
+    bool match(std::string_view input);
+    bool match(InputStream &input);
+
+    // Resumes a match whose threads entryPCs wait for input[position].
+    bool matchFrom(std::string_view input, size_t position,
+                   const std::vector<unsigned short> &entryPCs);
+    bool matchFrom(InputStream &input, size_t position,
+                   const std::vector<unsigned short> &entryPCs);
+
+    // Runs over the whole input, reporting the span of every accepting
+    // thread, and returns how many were reported. Spans come in order of
+    // their end.
+    size_t scan(std::string_view input, const MatchCallback &onMatch);
+};
+
+} // namespace Cicero
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ProgramAnalysis.h"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace Cicero {
+
+// Rejects inputs that cannot match a program before any engine runs on
+// them: an input must contain every required factor of the program, and one
+// of its first characters (at position 0 if the program has no `.*` loop).
+// A prefilter that cannot tell anything lets every input through.
+//
+// The searches use AVX2 or SSE4.2 when the processor has them, chosen at run
+// time, and plain loops otherwise.
+class Prefilter {
+  public:
+    // A character class as two tables of 16 bytes, for the vector searches:
+    // c is in the class if bit (c >> 4) % 8 of entry c % 16 of the lower
+    // (c < 128) or upper (c >= 128) table is set.
+    struct NibbleTable {
+        unsigned char lower[16];
+        unsigned char upper[16];
+
+        NibbleTable(const CharacterClass &characters);
+    };
+
+    struct CompiledFactor {
+        Factor classes;
+        // Of the first and last class, which find the candidate positions.
+        NibbleTable first;
+        NibbleTable last;
+
+        CompiledFactor(const Factor &factor);
+    };
+
+  private:
+    bool neverMatches;
+    bool anchored;
+    std::vector<CompiledFactor> factors; // Most selective first
+    bool filtersFirstCharacters;
+    CharacterClass firstCharacters;
+
+  public:
+    // Lets every input through.
+    Prefilter();
+    explicit Prefilter(const ProgramAnalysis &analysis);
+
+    bool mayMatch(const char *input, size_t length) const;
+    bool mayMatch(std::string_view input) const {
+        return mayMatch(input.data(), input.size());
+    }
+    // Whether some input can be rejected at all.
+    bool isSelective() const;
+
+    // Index of the first occurrence of factor in input, or length if there
+    // is none.
+    static size_t find(const char *input, size_t length,
+                       const CompiledFactor &factor);
+};
+
+} // namespace Cicero
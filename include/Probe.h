@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Buffers.h"
+#include "CoreOUT.h"
+#include "Instruction.h"
+#include "MatchSpan.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Cicero {
+
+// Probes observe the cycle accurate engine: BasicEngine and BasicCore are
+// templated on one, and call its hooks on every simulated event. NullProbe
+// has empty inline hooks, so that the engine instantiated with it compiles
+// to the same code as one without hooks.
+struct NullProbe {
+    void onStart(int /*windowSize*/) {}
+    void onCycle(int /*clockCycle*/, size_t /*windowIndex*/) {}
+    // A stage had no instruction to work on this cycle (stage 1 to 3).
+    void onStall(int /*stage*/) {}
+    void onFetch(CoreOUT /*thread*/, const Instruction & /*instruction*/) {}
+    void onExecute(CoreOUT /*thread*/, const Instruction & /*instruction*/,
+                   char /*currentChar*/) {}
+    // Stage 2 dropped a thread whose character is past the end of the input.
+    void onDrop(CoreOUT /*thread*/) {}
+    // A thread was pushed to the buffers by stage 2 or 3.
+    void onPush(const Buffers & /*buffers*/, CoreOUT /*thread*/,
+                int /*stage*/) {}
+    void onAccept(const MatchSpan & /*span*/) {}
+    void onSlide(unsigned short /*distance*/, size_t /*windowIndex*/) {}
+    // End of a match run by the engine itself, not by a Manager.
+    void onFinish(bool /*accepted*/) {}
+};
+
+// Counters of the simulated hardware over one match.
+struct EngineStats {
+    uint64_t clockCycles = 0;
+    uint64_t stalls[3] = {0, 0, 0}; // Cycles each stage was idle
+    uint64_t instructions[8] = {};  // Executed by stage 2, by InstrType
+    uint64_t accepts = 0;
+    uint64_t threads = 0;       // Pushed to the buffers by stages 2 and 3
+    uint64_t slides = 0;        // Times the window moved
+    uint64_t slideDistance = 0; // Characters it moved by, in total
+    // Largest number of threads each FIFO held at once.
+    std::vector<unsigned int> highWaterMarks;
+};
+
+class StatsProbe : public NullProbe {
+  private:
+    EngineStats stats;
+
+  public:
+    const EngineStats &getStats() const { return stats; }
+
+    void onStart(int windowSize) {
+        stats = EngineStats();
+        stats.highWaterMarks.assign(windowSize, 0);
+    }
+    void onCycle(int /*clockCycle*/, size_t /*windowIndex*/) {
+        stats.clockCycles++;
+    }
+    void onStall(int stage) { stats.stalls[stage - 1]++; }
+    void onExecute(CoreOUT /*thread*/, const Instruction &instruction,
+                   char /*currentChar*/) {
+        stats.instructions[instruction.getType()]++;
+    }
+    // Stage 2 did no work.
+    void onDrop(CoreOUT /*thread*/) { stats.stalls[1]++; }
+    void onPush(const Buffers &buffers, CoreOUT thread, int /*stage*/) {
+        stats.threads++;
+        unsigned short slot = thread.getCC_ID() % stats.highWaterMarks.size();
+        unsigned int occupancy = buffers.getOccupancy(slot);
+        if (occupancy > stats.highWaterMarks[slot])
+            stats.highWaterMarks[slot] = occupancy;
+    }
+    void onAccept(const MatchSpan & /*span*/) { stats.accepts++; }
+    void onSlide(unsigned short distance, size_t /*windowIndex*/) {
+        stats.slides++;
+        stats.slideDistance += distance;
+    }
+};
+
+} // namespace Cicero
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Const.h"
+#include "DecodedProgram.h"
+#include "Export.h"
+#include "Instruction.h"
+
+#include <vector>
+
+namespace Cicero {
+
+// Characters at consecutive positions, one from each class; a literal when
+// every class has a single character.
+using Factor = std::vector<CharacterClass>;
+
+// Static facts about a program, from its control flow graph: the PCs
+// reachable from PC 0, with an edge for each way a thread moves on (SPLIT
+// has two, ACCEPT and ACCEPT_PARTIAL lead to ACCEPT_NODE, and
+// END_WITHOUT_ACCEPTING has none). The MATCH_ANY of the `.*` loop leads
+// nowhere: it only restarts the match from PC 0, one character later.
+//
+// From the dominators of ACCEPT_NODE, the PCs every accepting thread runs
+// through, come the factors any matching input contains. From the PCs
+// reached before the first character is consumed come the characters a match
+// can start with.
+class CICERO_API ProgramAnalysis {
+  public:
+    static constexpr unsigned short NO_PC = 0xFFFF;
+    // Node standing for a thread having accepted.
+    static constexpr unsigned short ACCEPT_NODE = INSTR_MEM_SIZE;
+
+  private:
+    const Instruction *program;
+
+    std::vector<std::vector<unsigned short>> successors;  // [node]
+    std::vector<std::vector<unsigned short>> predecessors; // [node]
+    std::vector<unsigned short> order; // Reverse postorder from PC 0
+    std::vector<unsigned short> idoms; // [node], NO_PC if unreachable
+    std::vector<bool> live;            // [node], reaches ACCEPT_NODE
+
+    std::vector<unsigned short> requiredPCs;
+    unsigned short loop;
+    std::vector<Factor> factors;
+    CharacterClass firstCharacters;
+
+    void findLoop();
+    void buildGraph();
+    void computeDominators();
+    bool consumeBetween(unsigned short from, unsigned short to,
+                        CharacterClass &consumed, bool &consumes) const;
+    void findFactors();
+    void findFirstCharacters();
+
+  public:
+    explicit ProgramAnalysis(const Instruction *program);
+
+    bool isReachable(unsigned short node) const;
+    const std::vector<unsigned short> &getSuccessors(unsigned short node) const;
+    // NO_PC for PC 0 and for unreachable nodes.
+    unsigned short getImmediateDominator(unsigned short node) const;
+    bool dominates(unsigned short dominator, unsigned short node) const;
+
+    // Whether any thread can accept at all.
+    bool canAccept() const;
+    // PCs every accepting thread runs through, in the order it does.
+    const std::vector<unsigned short> &getRequiredPCs() const;
+
+    // The MATCH_ANY of the `.*` loop at PC 0, which lets a match start at
+    // any position, or NO_PC if matches can only start at position 0.
+    unsigned short getLoop() const;
+
+    // Factors every matching input contains, most selective first. Each
+    // class is what the threads consume between two consecutive required
+    // PCs, when all of them consume exactly one character there; classes
+    // matching any character are left out of both ends.
+    const std::vector<Factor> &getRequiredFactors() const;
+    // Characters one of which is the first a match consumes, after the
+    // loop. All are set when a match can consume anything first, or
+    // accept without consuming.
+    const CharacterClass &getFirstCharacters() const;
+};
+
+} // namespace Cicero
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Const.h"
+#include "Export.h"
+#include "Instruction.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Cicero {
+
+// Binary file holding many compiled programs, meant to be memory-mapped:
+//
+//   Header        "CICB", version, byte order mark, program count
+//   Index         (offset, length) of each program, in instructions
+//   Instructions  the 16 bit instruction words, in host byte order
+//
+// Opening a bundle validates it and maps it read-only; the programs are then
+// used in place, without being copied into a program memory.
+class CICERO_API ProgramBundle {
+  private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t programCount;
+    };
+
+    struct Entry {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    const unsigned char *mapping;
+    size_t mappingSize;
+    const Entry *index;
+    const Instruction *instructions;
+    size_t programCount;
+    uint64_t id;
+
+  public:
+    ProgramBundle();
+    ~ProgramBundle();
+    ProgramBundle(const ProgramBundle &) = delete;
+    ProgramBundle &operator=(const ProgramBundle &) = delete;
+
+    // Whether filename starts like a bundle, rather than a program file.
+    static bool isBundle(const char *filename);
+
+    bool open(const char *filename);
+    void close();
+    bool isOpen() const;
+    // Tells this opening of the bundle apart from any other in the process,
+    // so that what was derived from its programs can be kept until it is
+    // closed. 0 while closed.
+    uint64_t getId() const;
+
+    size_t getProgramCount() const;
+    // Points into the mapping, valid until the bundle is closed.
+    const Instruction *getProgram(size_t program) const;
+    size_t getProgramLength(size_t program) const;
+
+    // Replaces filename at once, as a whole.
+    static bool write(const char *filename,
+                      const std::vector<std::vector<Instruction>> &programs);
+
+    // Whether every PC reachable from program stays inside its length.
+    static bool isValidProgram(const Instruction *program, size_t length);
+};
+
+} // namespace Cicero
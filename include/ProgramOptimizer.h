@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Const.h"
+#include "Export.h"
+#include "Instruction.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Cicero {
+
+// What ProgramOptimizer did to a program.
+struct OptimizerStats {
+    size_t originalLength = 0;
+    size_t optimizedLength = 0;
+    size_t threadedJumps = 0;    // JMP and SPLIT retargeted past a JMP chain
+    size_t inlinedTerminals = 0; // JMP replaced by the instruction it reached
+    size_t foldedSplits = 0;     // SPLIT with both ways to the same PC
+    size_t removedNops = 0;      // JMP or SPLIT only leading to the next PC
+    size_t removedUnreachable = 0;
+    // Runs of MATCH only entered from their first instruction, as (PC,
+    // length) in the optimized program: literals a multi-character MATCH
+    // could consume at once.
+    std::vector<std::pair<unsigned short, unsigned short>> literalRuns;
+};
+
+// Rewrites a program into an equivalent one with fewer instructions, which
+// the engines execute in fewer clock cycles:
+//
+//   jump threading   a JMP or SPLIT to a JMP goes straight to where the chain
+//                    ends, and a JMP to ACCEPT, ACCEPT_PARTIAL or
+//                    END_WITHOUT_ACCEPTING that nothing else leads to
+//                    becomes that instruction
+//   folding          a SPLIT whose two ways end on the same PC becomes a JMP
+//   dead code        instructions no thread reaches from PC 0 are dropped,
+//                    as are the JMP and SPLIT that only lead to the next PC
+//
+// The rest is moved up and the jump targets renumbered; PC 0 stays the
+// entry, as the match start is taken there. Threads reach the same
+// consuming and accepting instructions in the same priority order, so the
+// verdicts and the match spans do not change.
+class CICERO_API ProgramOptimizer {
+  private:
+    std::vector<Instruction> optimized;
+    OptimizerStats stats;
+
+    // Where a thread sent to PC first does something other than jumping.
+    static unsigned short resolve(const Instruction *program,
+                                  unsigned short PC);
+
+  public:
+    // program holds INSTR_MEM_SIZE instructions, of which length were
+    // loaded (only used for the stats), or comes from a bundle.
+    explicit ProgramOptimizer(const Instruction *program,
+                              size_t length = INSTR_MEM_SIZE);
+
+    const std::vector<Instruction> &getProgram() const;
+    const OptimizerStats &getStats() const;
+
+    // The PCs a thread can reach from PC 0, the only ones read.
+    static std::vector<bool> findReachable(const Instruction *program);
+    // FNV-1a over the reachable instructions and their PCs, its offset basis
+    // xored with seed.
+    static uint64_t hashReachable(const Instruction *program,
+                                  const std::vector<bool> &reachable,
+                                  uint64_t seed = 0);
+};
+
+} // namespace Cicero
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Arena.h"
+
+#include <cstdint>
+
+namespace Cicero {
+
+// One bit per window slot, with search for the first set slot in circular
+// order from the head of the window. Kept inline: it is queried several
+// times per simulated clock cycle. Its words live in the arena of the
+// engine.
+class SlotMask {
+  private:
+    uint64_t *words;
+    int wordCount;
+    int size;
+
+    // Offset of the first set bit in [first, last), or last - first.
+    int findInRange(int first, int last) const {
+        int wordIndex = first >> 6;
+        uint64_t word = words[wordIndex] & (~uint64_t(0) << (first & 63));
+
+        while (true) {
+            if (word != 0) {
+                int found = (wordIndex << 6) + __builtin_ctzll(word);
+                return found < last ? found - first : last - first;
+            }
+            wordIndex++;
+            if ((wordIndex << 6) >= last)
+                return last - first;
+            word = words[wordIndex];
+        }
+    }
+
+  public:
+    SlotMask(int n, Arena &arena)
+        : words(arena.allocate<uint64_t>((n + 63) / 64)),
+          wordCount((n + 63) / 64), size(n) {
+        clearAll();
+    }
+
+    void set(int slot) { words[slot >> 6] |= uint64_t(1) << (slot & 63); }
+    void clear(int slot) { words[slot >> 6] &= ~(uint64_t(1) << (slot & 63)); }
+    bool test(int slot) const { return (words[slot >> 6] >> (slot & 63)) & 1; }
+
+    void clearAll() {
+        for (int i = 0; i < wordCount; i++) {
+            words[i] = 0;
+        }
+    }
+
+    bool none() const {
+        for (int i = 0; i < wordCount; i++) {
+            if (words[i] != 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Sets the slots set in other, of the same size.
+    void merge(const SlotMask &other) {
+        for (int i = 0; i < wordCount; i++) {
+            words[i] |= other.words[i];
+        }
+    }
+
+    // Distance from head of the first set slot among the count slots that
+    // follow it (wrapping around), or count if they are all clear. Windows
+    // of up to 64 slots are rotated so that head comes first, and the
+    // distance is the number of trailing zeros.
+    int findFrom(int head, int count) const {
+        if (count <= 0)
+            return 0;
+        if (size <= 64) {
+            uint64_t word = words[0];
+            if (head != 0)
+                word = (word >> head) | (word << (size - head));
+            if (count < 64)
+                word &= (uint64_t(1) << count) - 1;
+            return word != 0 ? __builtin_ctzll(word) : count;
+        }
+        if (head + count <= size)
+            return findInRange(head, head + count);
+
+        int found = findInRange(head, size);
+        if (found < size - head)
+            return found;
+        return size - head + findInRange(0, head + count - size);
+    }
+};
+
+} // namespace Cicero
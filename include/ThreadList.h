@@ -0,0 +1,187 @@
+#pragma once
+
+#include "Const.h"
+#include "MatchSpan.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace Cicero {
+
+// The thread lists of a Pike VM, and the step that follows the epsilon
+// closure of a thread, shared by the executors that run programs as one
+// (PikeVM, PatternSet). Program reads the instruction words of what is run:
+//
+//   using Address = ...;               // A PC
+//   size_t size() const;               // PCs from there on end the thread
+//   unsigned char getType(Address PC) const;  // With MATCH_SET decoded
+//   Address getNext(Address PC) const;
+//   Address getTarget(Address PC) const;      // Of SPLIT and JMP
+//   // Whether a thread on the MATCH, MATCH_ANY, MATCH_SET or NOT_MATCH at
+//   // PC goes on to the next one on currentChar.
+//   bool isAccepted(Address PC, char currentChar) const;
+//
+// The Verdict given to addThread decides what becomes of the threads that
+// reach ACCEPT (on '\0' only), ACCEPT_PARTIAL and END_WITHOUT_ACCEPTING;
+// anything but CONTINUE ends the step at once:
+//
+//   ClockResult accept(Address PC, const MatchSpan &span);
+//   ClockResult stop(Address PC);
+template <class Program> class ThreadList {
+  public:
+    using Address = typename Program::Address;
+
+  private:
+    // Consuming instructions (MATCH, MATCH_ANY, MATCH_SET) reached by the
+    // epsilon closure of the current character, in priority order, and the
+    // start of their match.
+    std::vector<Address> threads;
+    std::vector<size_t> threadStarts;
+
+    // onList[PC] == generation iff PC was already followed for the current
+    // character, queued[PC] == generation iff PC was already queued for the
+    // next one.
+    std::vector<unsigned int> onList;
+    std::vector<unsigned int> queued;
+    unsigned int generation = 0;
+
+    // Pending SPLIT targets (and match starts) while following the epsilon
+    // closure.
+    std::vector<std::pair<Address, size_t>> stack;
+
+  public:
+    // For a program of size instructions.
+    void resize(size_t size) {
+        threads.reserve(size);
+        threadStarts.reserve(size);
+        stack.reserve(size);
+        onList.assign(size, 0);
+        queued.assign(size, 0);
+        generation = 0;
+    }
+
+    // Starts the closure of a new character.
+    void clear() {
+        threads.clear();
+        threadStarts.clear();
+        generation++;
+        if (generation == 0) { // Wrapped around, stale marks could collide.
+            std::fill(onList.begin(), onList.end(), 0);
+            std::fill(queued.begin(), queued.end(), 0);
+            generation = 1;
+        }
+    }
+
+    // Whether PC was not queued for the next character yet, queuing it.
+    bool queue(Address PC) {
+        if (queued[PC] == generation)
+            return false;
+        queued[PC] = generation;
+        return true;
+    }
+
+    // Follows the epsilon closure of PC for the character at position, in
+    // the same priority order as the hardware (SPLIT continues on the next
+    // PC first), and appends the consuming instructions reached to the
+    // threads.
+    template <class Verdict>
+    ClockResult addThread(const Program &program, Address PC, size_t start,
+                          char currentChar, size_t position,
+                          Verdict &verdict) {
+        const Address end = program.size();
+        stack.clear();
+        stack.emplace_back(PC, start);
+
+        while (!stack.empty()) {
+            PC = stack.back().first;
+            start = stack.back().second;
+            stack.pop_back();
+
+            while (PC < end && onList[PC] != generation) {
+                onList[PC] = generation;
+                ClockResult result = CONTINUE;
+
+                // Passing PC 0 (re)starts the match at the current character.
+                if (PC == 0)
+                    start = position;
+
+                switch (program.getType(PC)) {
+
+                case ACCEPT:
+                    if (currentChar == '\0')
+                        result = verdict.accept(PC, MatchSpan{start, position});
+                    PC = end;
+                    break;
+
+                case SPLIT:
+                    stack.emplace_back(program.getTarget(PC), start);
+                    PC = program.getNext(PC);
+                    break;
+
+                case MATCH:
+                case MATCH_ANY:
+                case MATCH_SET:
+                    threads.push_back(PC);
+                    threadStarts.push_back(start);
+                    PC = end;
+                    break;
+
+                case JMP:
+                    PC = program.getTarget(PC);
+                    break;
+
+                case END_WITHOUT_ACCEPTING:
+                    result = verdict.stop(PC);
+                    PC = end;
+                    break;
+
+                case ACCEPT_PARTIAL:
+                    result = verdict.accept(PC, MatchSpan{start, position});
+                    PC = end;
+                    break;
+
+                case NOT_MATCH:
+                    if (program.isAccepted(PC, currentChar))
+                        PC = program.getNext(PC);
+                    else
+                        PC = end;
+                    break;
+
+                default:
+                    fprintf(stderr, "[X] Malformed instruction found.");
+                    PC = end;
+                    break;
+                }
+
+                if (result != CONTINUE)
+                    return result;
+            }
+        }
+
+        return CONTINUE;
+    }
+
+    // Queues in next, once each, the PCs the threads go on to on
+    // currentChar, and their match starts in nextStarts unless it is null.
+    // Only the PCs keep returns true for are queued.
+    template <class Keep>
+    void consume(const Program &program, char currentChar,
+                 std::vector<Address> &next, std::vector<size_t> *nextStarts,
+                 Keep keep) {
+        for (size_t i = 0; i < threads.size(); i++) {
+            Address PC = program.getNext(threads[i]);
+
+            if (program.isAccepted(threads[i], currentChar) &&
+                PC < program.size() && keep(PC) && queue(PC)) {
+                next.push_back(PC);
+                if (nextStarts != nullptr)
+                    nextStarts->push_back(threadStarts[i]);
+            }
+        }
+    }
+};
+
+} // namespace Cicero
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Cicero {
+
+// Runs a range of independent tasks on a set of worker threads. Each worker
+// gets a contiguous slice of the range in its own deque and consumes it from
+// the front, so that neighbouring tasks (which share a program) run on the
+// same worker; a worker that runs out steals from the back of the others.
+//
+// The threads are started with the pool and wait between runs, so that a
+// run does not pay for creating them.
+class ThreadPool {
+  private:
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    unsigned workerCount;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    // Workers 1 and up; the thread calling run is worker 0.
+    std::vector<std::thread> threads;
+
+    std::mutex lock;
+    std::condition_variable wake; // A run started, or the pool is stopping
+    std::condition_variable done; // The last worker of a run finished
+    const std::function<void(unsigned, size_t)> *body = nullptr;
+    uint64_t round = 0; // Runs started so far
+    unsigned busy = 0;  // Threads still working on the current run
+    bool stopping = false;
+
+    void loop(unsigned worker);
+    bool popOwn(unsigned worker, size_t &task);
+    bool steal(unsigned thief, size_t &task);
+    void work(unsigned worker,
+              const std::function<void(unsigned, size_t)> &body);
+
+  public:
+    // 0 workers means one per hardware thread.
+    ThreadPool(unsigned workers = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned getWorkerCount() const;
+
+    // Calls body(worker, task) once for every task in [0, taskCount) and
+    // returns when all of them are done. worker is in [0, workerCount), and
+    // a given worker never runs two tasks at the same time. Runs do not
+    // overlap: run is not called from two threads at once.
+    void run(size_t taskCount,
+             const std::function<void(unsigned, size_t)> &body);
+};
+
+} // namespace Cicero
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Buffers.h"
+#include "CoreOUT.h"
+#include "Instruction.h"
+#include "MatchSpan.h"
+#include "Probe.h"
+
+#include <cstddef>
+#include <cstdio>
+
+namespace Cicero {
+
+// Writes every simulated event as one JSON object per line, to be diffed
+// against a trace of the RTL simulation. Each line carries the clock cycle
+// and the event, e.g.
+//
+//   {"cycle":3,"event":"fetch","pc":2,"cc_id":0,"type":"MATCH","data":97}
+//
+// Characters are written as their code, to keep the lines plain ASCII.
+class TraceProbe : public NullProbe {
+  private:
+    FILE *output = stdout;
+    int clockCycle = 0;
+
+    void begin(const char *event);
+
+  public:
+    // Where the trace is written, stdout by default.
+    void setOutput(FILE *file);
+
+    void onStart(int windowSize);
+    void onCycle(int clockCycle, size_t windowIndex);
+    void onStall(int stage);
+    void onFetch(CoreOUT thread, const Instruction &instruction);
+    void onExecute(CoreOUT thread, const Instruction &instruction,
+                   char currentChar);
+    void onDrop(CoreOUT thread);
+    void onPush(const Buffers &buffers, CoreOUT thread, int stage);
+    void onAccept(const MatchSpan &span);
+    void onSlide(unsigned short distance, size_t windowIndex);
+    void onFinish(bool accepted);
+};
+
+} // namespace Cicero
@@ -0,0 +1,48 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+namespace Cicero {
+
+Arena::Arena() : current(0), used(0) {}
+
+// Goes on to the next block when the current one is full, and allocates one
+// (large enough for the request) when there is none left.
+void *Arena::allocate(size_t size, size_t alignment) {
+    while (current < blocks.size()) {
+        Block &block = blocks[current];
+        uintptr_t base = uintptr_t(block.memory.get());
+        size_t offset = ((base + used + alignment - 1) & ~(alignment - 1)) -
+                        base;
+        if (offset + size <= block.size) {
+            used = offset + size;
+            return block.memory.get() + offset;
+        }
+        current++;
+        used = 0;
+    }
+
+    size_t blockSize = std::max(BLOCK_SIZE, size + alignment);
+    blocks.push_back(
+        Block{std::make_unique<unsigned char[]>(blockSize), blockSize});
+    current = blocks.size() - 1;
+    used = 0;
+    return allocate(size, alignment);
+}
+
+void Arena::reset() {
+    current = 0;
+    used = 0;
+}
+
+size_t Arena::getCapacity() const {
+    size_t capacity = 0;
+    for (auto &block : blocks) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+
+} // namespace Cicero
@@ -0,0 +1,225 @@
+#include "BitParallelNFA.h"
+
+#include <string_view>
+#include <vector>
+
+namespace Cicero {
+
+BitParallelNFA::BitParallelNFA(const Instruction *program)
+    : decoded(program), ownTables(decoded), tables(&ownTables),
+      fallback(decoded) {}
+
+BitParallelNFA::BitParallelNFA(const DecodedProgram &program)
+    : ownTables(program), tables(&ownTables), fallback(program) {}
+
+void BitParallelNFA::setProgram(const Instruction *program) {
+    decoded.decode(program);
+    setProgram(decoded);
+}
+
+void BitParallelNFA::setProgram(const DecodedProgram &program) {
+    fallback.setProgram(program);
+    ownTables = Tables(program);
+    tables = &ownTables;
+}
+
+void BitParallelNFA::setProgram(const DecodedProgram &program,
+                                const Tables &tables, LazyDFA::Cache &cache) {
+    fallback.setProgram(program, cache);
+    this->tables = &tables;
+}
+
+bool BitParallelNFA::isBitParallel() const { return tables->bitParallel; }
+
+int BitParallelNFA::getStateCount() const { return tables->statePCs.size(); }
+
+void BitParallelNFA::setMemoryLimit(size_t memoryLimit) {
+    fallback.setMemoryLimit(memoryLimit);
+}
+
+size_t BitParallelNFA::Tables::getMemoryUsed() const {
+    return statePCs.capacity() * sizeof(unsigned short) +
+           (closures.capacity() + consumers.capacity() +
+            notMatchPassing.capacity()) *
+               sizeof(StateSet);
+}
+
+BitParallelNFA::Tables::Tables(const DecodedProgram &program) {
+    statePCs.assign(1, 0);
+    std::vector<int> stateOf(INSTR_MEM_SIZE, -1);
+    bitParallel = true;
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (!program.isReachable(PC))
+            continue;
+        switch (program[PC].type) {
+        case SPLIT:
+        case JMP:
+            break;
+        case END_WITHOUT_ACCEPTING:
+            bitParallel = false;
+            break;
+        default:
+            stateOf[PC] = statePCs.size();
+            statePCs.push_back(PC);
+            break;
+        }
+    }
+    if (statePCs.size() > MAX_STATES)
+        bitParallel = false;
+    if (!bitParallel) {
+        statePCs.clear();
+        closures.clear();
+        return;
+    }
+
+    // Closure of each state on its own: the states reached through SPLIT
+    // and JMP from where its thread goes on. Accepting states go nowhere.
+    std::vector<StateSet> single(statePCs.size());
+    std::vector<bool> visited(INSTR_MEM_SIZE);
+    std::vector<unsigned short> pending;
+    for (size_t state = 0; state < statePCs.size(); state++) {
+        unsigned short type = program[statePCs[state]].type;
+        if (state != START && (type == ACCEPT || type == ACCEPT_PARTIAL))
+            continue;
+
+        visited.assign(INSTR_MEM_SIZE, false);
+        pending.assign(1, state == START ? 0 : statePCs[state] + 1);
+        while (!pending.empty()) {
+            unsigned short PC = pending.back();
+            pending.pop_back();
+            if (PC >= INSTR_MEM_SIZE || visited[PC])
+                continue;
+            visited[PC] = true;
+
+            const DecodedInstruction &instr = program[PC];
+            if (instr.type == SPLIT) {
+                pending.push_back(instr.target);
+                pending.push_back(instr.next);
+            } else if (instr.type == JMP) {
+                pending.push_back(instr.target);
+            } else if (stateOf[PC] >= 0) {
+                single[state].set(stateOf[PC]);
+            }
+        }
+    }
+
+    // Each entry adds the closure of its lowest set bit to the entry
+    // without it.
+    chunkCount = (statePCs.size() + 7) / 8;
+    closures.assign(chunkCount * 256, StateSet());
+    for (int chunk = 0; chunk < chunkCount; chunk++) {
+        for (int byte = 1; byte < 256; byte++) {
+            size_t state = chunk * 8 + __builtin_ctz(byte);
+            closures[chunk * 256 + byte] =
+                closures[chunk * 256 + (byte & (byte - 1))];
+            if (state < single.size())
+                closures[chunk * 256 + byte] |= single[state];
+        }
+    }
+
+    consumers.assign(256, StateSet());
+    notMatchPassing.assign(256, StateSet());
+    notMatches = accepts = partialAccepts = StateSet();
+    for (size_t state = 1; state < statePCs.size(); state++) {
+        const DecodedInstruction &instr = program[statePCs[state]];
+        for (int c = 0; c < 256; c++) {
+            if (!instr.accepted[c])
+                continue;
+            if (instr.type == NOT_MATCH)
+                notMatchPassing[c].set(state);
+            else
+                consumers[c].set(state);
+        }
+        if (instr.type == NOT_MATCH)
+            notMatches.set(state);
+        else if (instr.type == ACCEPT)
+            accepts.set(state);
+        else if (instr.type == ACCEPT_PARTIAL)
+            partialAccepts.set(state);
+    }
+}
+
+BitParallelNFA::StateSet
+BitParallelNFA::closure(const StateSet &arrived) const {
+    StateSet reached;
+    for (int chunk = 0; chunk < tables->chunkCount; chunk++) {
+        unsigned int byte = (arrived.words[chunk / 8] >> (chunk % 8 * 8)) & 255;
+        if (byte != 0)
+            reached |= tables->closures[chunk * 256 + byte];
+    }
+    return reached;
+}
+
+// Same outcomes as PikeVM::step. A NOT_MATCH letting the character through
+// arrives at the next PC without consuming it, hence the loop.
+ClockResult BitParallelNFA::step(StateSet &arrived,
+                                 unsigned char currentChar) const {
+    const Tables &tables = *this->tables;
+    StateSet waiting = closure(arrived);
+    StateSet passed = waiting & tables.notMatchPassing[currentChar];
+    StateSet followed;
+    while (passed.any()) {
+        followed |= passed;
+        waiting |= closure(passed);
+        passed = (waiting & tables.notMatchPassing[currentChar])
+                     .without(followed);
+    }
+
+    if ((waiting & tables.partialAccepts).any() ||
+        (currentChar == '\0' && (waiting & tables.accepts).any()))
+        return ACCEPTED;
+
+    arrived = waiting & tables.consumers[currentChar];
+    return arrived.any() ? CONTINUE : REFUSED;
+}
+
+bool BitParallelNFA::match(std::string_view input) {
+    if (!tables->bitParallel)
+        return fallback.match(input);
+
+    StateSet arrived;
+    arrived.set(START);
+
+    // The character following the input is '\0'.
+    for (size_t i = 0; i <= input.size(); i++) {
+        ClockResult result =
+            step(arrived, i < input.size() ? input[i] : '\0');
+        if (result != CONTINUE)
+            return result == ACCEPTED;
+    }
+
+    // Threads moving past the terminating '\0' are dropped.
+    return false;
+}
+
+bool BitParallelNFA::match(InputStream &input) {
+    if (!tables->bitParallel)
+        return fallback.match(input);
+
+    StateSet arrived;
+    arrived.set(START);
+    size_t position = 0;
+
+    while (true) {
+        // Once the stream has no more characters, its '\0' terminator is
+        // fed as a chunk of its own.
+        size_t available = input.request(position, 1);
+        const char *chunk = available > 0 ? input.at(position) : "";
+        size_t count = available > 0 ? available : 1;
+
+        for (size_t i = 0; i < count; i++) {
+            ClockResult result = step(arrived, chunk[i]);
+            if (result != CONTINUE)
+                return result == ACCEPTED;
+        }
+
+        // Threads moving past the terminating '\0' are dropped.
+        if (available == 0)
+            return false;
+
+        position += available;
+        input.release(position);
+    }
+}
+
+} // namespace Cicero
@@ -1,82 +1,156 @@
 #include "Buffers.h"
 
+#include <algorithm>
 #include <cstdio>
-#include <queue>
 
 namespace Cicero {
 
 // Container for all the buffers - permits to instantiate a variable number of
 // buffers.
-Buffers::Buffers(int n) {
+Buffers::Buffers(int n, Arena &arena, unsigned int programSize,
+                 bool deduplicate)
+    : arena(&arena), occupied(n, arena) {
     size = n;
-    buffers.reserve(n);
-    for (int i = 0; i < n; i++) {
-        buffers.push_back(std::queue<unsigned short>());
+    this->deduplicate = deduplicate;
+    visited = nullptr;
+    if (deduplicate) {
+        visited = arena.allocate<uint64_t>(size * VISITED_WORDS);
+        std::fill(visited, visited + size * VISITED_WORDS, 0);
+    }
+    capacity = 1;
+    while (capacity < programSize) {
+        capacity <<= 1;
+    }
+    storage = arena.allocate<unsigned short>(size * capacity);
+    starts = arena.allocate<size_t>(size * capacity);
+    heads = arena.allocate<unsigned int>(size);
+    tails = arena.allocate<unsigned int>(size);
+    std::fill(heads, heads + size, 0);
+    std::fill(tails, tails + size, 0);
+}
+
+void Buffers::reserve(unsigned int programSize) {
+    while (capacity < programSize) {
+        grow();
     }
 }
 
+// Empty buffers get their counters reset on the next push, so only the
+// occupancy mask needs clearing.
 void Buffers::flush() {
+    occupied.clearAll();
+    if (deduplicate)
+        std::fill(visited, visited + size * VISITED_WORDS, 0);
+}
+
+void Buffers::slide(unsigned short HEAD, unsigned short distance) {
+    if (!deduplicate)
+        return;
+    for (unsigned short i = 0; i < distance && i < size; i++) {
+        uint64_t *words = &visited[(HEAD + i) % size * VISITED_WORDS];
+        std::fill(words, words + VISITED_WORDS, 0);
+    }
+}
+
+// Doubles the capacity of every buffer, moving their contents to the start of
+// the new rings.
+void Buffers::grow() {
+    unsigned int newCapacity = capacity << 1;
+    unsigned short *newStorage =
+        arena->allocate<unsigned short>(size * newCapacity);
+    size_t *newStarts = arena->allocate<size_t>(size * newCapacity);
+
     for (int i = 0; i < size; i++) {
-        while (!buffers[i].empty()) {
-            buffers[i].pop();
+        unsigned int count = occupied.test(i) ? tails[i] - heads[i] : 0;
+        for (unsigned int j = 0; j < count; j++) {
+            unsigned int from =
+                i * capacity + ((heads[i] + j) & (capacity - 1));
+            newStorage[i * newCapacity + j] = storage[from];
+            newStarts[i * newCapacity + j] = starts[from];
         }
+        heads[i] = 0;
+        tails[i] = count;
     }
+
+    storage = newStorage;
+    starts = newStarts;
+    capacity = newCapacity;
 }
 
 bool Buffers::isEmpty(unsigned short CC_ID) {
-    return buffers[(CC_ID) % size].empty();
+    return !occupied.test((CC_ID) % size);
 }
 
 // Expects to be told which is the buffer holding first character of sliding
 // window.
 bool Buffers::hasInstructionReady(unsigned short HEAD) {
-    for (int i = 0; i < size - 1;
-         i++) { // Excludes the last buffer of the sliding window.
-        if (!buffers[(HEAD + i) % size].empty()) {
-            return true;
-        }
-    }
-    return false;
+    // Excludes the last buffer of the sliding window.
+    return occupied.findFrom(HEAD, size - 1) < size - 1;
 }
 
 unsigned short Buffers::getFirstNotEmpty(unsigned short HEAD) {
-    for (int i = 0; i < size - 1; i++) { // Cannot return the inactive one.
-
-        if (!buffers[(HEAD + i) % size].empty()) {
-            return (HEAD + i) % size;
-        }
-    }
+    // Cannot return the inactive one.
+    int offset = occupied.findFrom(HEAD, size - 1);
+    if (offset < size - 1)
+        return (HEAD + offset) % size;
     return size; // To be considered as all empty.
 }
 
-bool Buffers::areAllEmpty() {
-    bool areEmpty = true;
-    for (int i = 0; i < size; i++) {
-        if (!buffers[i].empty()) {
-            areEmpty = false;
-            break;
-        }
-    }
-    return areEmpty;
+bool Buffers::areAllEmpty() { return occupied.none(); }
+
+unsigned int Buffers::getOccupancy(unsigned short CC_ID) const {
+    int i = (CC_ID) % size;
+    return occupied.test(i) ? tails[i] - heads[i] : 0;
 }
 
 CoreOUT Buffers::getPC(unsigned short CC_ID) {
-    CoreOUT PC = CoreOUT(buffers[(CC_ID) % size].front(), CC_ID);
+    int i = (CC_ID) % size;
+    CoreOUT PC = CoreOUT(storage[i * capacity + (heads[i] & (capacity - 1))],
+                         CC_ID);
     return PC;
 }
 
+size_t Buffers::getStart(unsigned short CC_ID) {
+    int i = (CC_ID) % size;
+    return starts[i * capacity + (heads[i] & (capacity - 1))];
+}
+
 CoreOUT Buffers::popPC(unsigned short CC_ID) {
-    CoreOUT PC = CoreOUT(buffers[(CC_ID) % size].front(), CC_ID);
-    buffers[(CC_ID) % size].pop();
+    int i = (CC_ID) % size;
+    CoreOUT PC = CoreOUT(storage[i * capacity + (heads[i] & (capacity - 1))],
+                         CC_ID);
+    heads[i]++;
+    if (heads[i] == tails[i])
+        occupied.clear(i);
     return PC;
 }
 
-void Buffers::pushTo(unsigned short CC_ID, unsigned short PC) {
+bool Buffers::pushTo(unsigned short CC_ID, unsigned short PC, size_t start) {
 
     if (CC_ID < size) {
-        buffers[(CC_ID) % size].push(PC);
-    } else
-        fprintf(stderr, "[X] Pushing to non-existing buffer %d.\n", CC_ID);
+        if (deduplicate) {
+            uint64_t &word = visited[CC_ID * VISITED_WORDS + PC / 64];
+            uint64_t bit = uint64_t(1) << (PC % 64);
+            if (word & bit)
+                return false;
+            word |= bit;
+        }
+
+        if (!occupied.test(CC_ID)) {
+            heads[CC_ID] = 0;
+            tails[CC_ID] = 0;
+            occupied.set(CC_ID);
+        } else if (tails[CC_ID] - heads[CC_ID] == capacity) {
+            grow();
+        }
+        unsigned int to = CC_ID * capacity + (tails[CC_ID]++ & (capacity - 1));
+        storage[to] = PC;
+        starts[to] = start;
+        return true;
+    }
+
+    fprintf(stderr, "[X] Pushing to non-existing buffer %d.\n", CC_ID);
+    return false;
 }
 
 } // namespace Cicero
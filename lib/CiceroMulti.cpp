@@ -1,68 +1,434 @@
 #include "CiceroMulti.h"
 #include "Buffers.h"
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <deque>
 #include <iostream>
 #include <memory>
 #include <queue>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 namespace Cicero {
 
+// Prepared once, then only read by the object that prepared it and its
+// workers, but for the DFA states, which each of them discovers on its own.
+struct CiceroMulti::PreparedProgram {
+    // The reachable instructions of the program, the others left as
+    // ACCEPT, which tell it from other programs with the same hash.
+    Instruction source[INSTR_MEM_SIZE];
+    // The program rewritten with MATCH_SET, and its class table.
+    Instruction classProgram[INSTR_MEM_SIZE];
+    std::vector<CharacterClass> classes;
+    Instruction optimizedProgram[INSTR_MEM_SIZE];
+    // What the prefilter and the JIT work on, without MATCH_SET.
+    const Instruction *plainProgram = nullptr;
+    DecodedProgram decoded;
+    Prefilter prefilter; // Once hasPrefilter
+    bool hasPrefilter = false;
+    BitParallelNFA::Tables tables;           // In BIT_PARALLEL mode
+    JitVM::MatchFunction compiled = nullptr; // In JIT mode
+    // In LAZY_DFA and BIT_PARALLEL modes, by cacheSlot. Only grows, which
+    // leaves the caches in use where they are.
+    std::deque<LazyDFA::Cache> dfaCaches;
+    uint64_t hash = 0;
+    size_t memory = 0; // Bytes, but for the DFA states, once built
+};
+
 // Wrapper class that holds and inits all components.
-CiceroMulti::CiceroMulti(unsigned short W, bool dbg) {
+CiceroMulti::CiceroMulti(unsigned short W, bool dbg, ExecutionMode mode) {
 
     if (W == 0)
         W = 1;
 
     hasProgram = false;
+    windowSize = W;
     verbose = dbg;
+    this->mode = mode;
+    usePrefilter = mode != CYCLE_ACCURATE;
 
-    engine = std::make_unique<Engine>(program, W + 1, dbg);
+    unset.decode(program);
+    engine = arena.make<Engine>(unset, W + 1, false, &arena);
+    if (dbg)
+        traceEngine = arena.make<BasicEngine<TraceProbe>>(unset, W + 1,
+                                                          false, &arena);
+    pikeVM = std::make_unique<PikeVM>(unset);
+    if (mode == LAZY_DFA)
+        dfa = std::make_unique<LazyDFA>(unset);
+    if (mode == BIT_PARALLEL)
+        bitNFA = std::make_unique<BitParallelNFA>(unset);
+    if (mode == LOCKSTEP)
+        lockstepVM = std::make_unique<LockstepVM>(unset);
+    if (mode == JIT)
+        jitVM = std::make_unique<JitVM>(program);
+    applyMemoryLimit();
 }
 
+// Stops the batch threads before their workers go away.
+CiceroMulti::~CiceroMulti() { pool.reset(); }
+
 void CiceroMulti::setProgram(const char *filename) {
+    trimPrepared();
+    hasProgram = readProgram(filename, program, verbose);
+    if (!hasProgram)
+        return;
+
+    bindLoaded();
+}
+
+void CiceroMulti::setProgram(const ProgramBundle &bundle, size_t index) {
+    if (index >= bundle.getProgramCount()) {
+        fprintf(stderr, "[X] The bundle has no program %zu.\n", index);
+        hasProgram = false;
+        return;
+    }
+
+    if (verbose) {
+        printf("Using program %zu of the bundle: \n\n", index);
+        for (size_t i = 0; i < bundle.getProgramLength(index); i++) {
+            bundle.getProgram(index)[i].print(i);
+        }
+    }
+
+    trimPrepared();
+    std::vector<PreparedProgram *> &programs = bundlePrograms[bundle.getId()];
+    if (programs.empty())
+        programs.assign(bundle.getProgramCount(), nullptr);
+    if (programs[index] == nullptr)
+        programs[index] = &prepare(bundle.getProgram(index));
+
+    hasProgram = true;
+    bindProgram(*programs[index]);
+}
+
+bool CiceroMulti::readProgram(const char *filename, Instruction *program,
+                              bool verbose, size_t *length) {
     FILE *fp = fopen(filename, "r");
     unsigned short instr;
     int i;
 
-    if (fp != NULL) {
+    if (fp == NULL) {
+        fprintf(stderr, "[X] Could not open program file %s for reading.\n",
+                filename);
+        return false;
+    }
 
-        if (verbose)
-            printf("Reading program file: \n\n");
+    if (verbose)
+        printf("Reading program file: \n\n");
 
-        for (i = 0; i < INSTR_MEM_SIZE && !feof(fp); i++) {
+    for (i = 0; i < INSTR_MEM_SIZE && !feof(fp); i++) {
 
-            fscanf(fp, "%hx", &instr);
-            program[i] = Instruction(instr);
-            fscanf(fp, "\n");
+        fscanf(fp, "%hx", &instr);
+        program[i] = Instruction(instr);
+        fscanf(fp, "\n");
 
-            // Pretty print instructions
-            if (verbose)
-                program[i].print(i);
-        }
+        // Pretty print instructions
+        if (verbose)
+            program[i].print(i);
+    }
 
-        if (i == INSTR_MEM_SIZE && !feof(fp)) {
-            fprintf(
-                stderr,
+    if (i == INSTR_MEM_SIZE && !feof(fp)) {
+        fprintf(stderr,
                 "[X] Program memory exceeded. Only the first %x instructions "
                 "were read.\n",
                 INSTR_MEM_SIZE);
+    }
+
+    if (length != nullptr)
+        *length = i;
+
+    fclose(fp);
+    return true;
+}
+
+CiceroMulti::PreparedProgram &
+CiceroMulti::findPrepared(const Instruction *program, bool &added) {
+    std::vector<bool> reachable = ProgramOptimizer::findReachable(program);
+    uint64_t hash = ProgramOptimizer::hashReachable(program, reachable);
+
+    auto range = this->prepared.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Instruction *source = it->second->source;
+        bool same = true;
+        for (int PC = 0; PC < INSTR_MEM_SIZE && same; PC++) {
+            same = !reachable[PC] ||
+                   (program[PC].getType() == source[PC].getType() &&
+                    program[PC].getData() == source[PC].getData());
         }
+        if (same) {
+            added = false;
+            return *it->second;
+        }
+    }
 
-        hasProgram = true;
-        fclose(fp);
-    } else {
-        hasProgram = false;
-        fprintf(stderr, "[X] Could not open program file %s for reading.\n",
-                filename);
+    auto prepared = std::make_unique<PreparedProgram>();
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (reachable[PC])
+            prepared->source[PC] = program[PC];
     }
-};
+    prepared->hash = hash;
+    added = true;
+    return *this->prepared.emplace(hash, std::move(prepared))->second;
+}
+
+void CiceroMulti::build(PreparedProgram &prepared) const {
+    const Instruction *program = prepared.source;
+    prepared.plainProgram = program;
+    prepared.classes.clear();
+    if (characterClasses) {
+        ClassRewriter rewriter(program);
+        std::copy(rewriter.getProgram().begin(), rewriter.getProgram().end(),
+                  prepared.classProgram);
+        prepared.classes = rewriter.getClasses();
+        program = prepared.classProgram;
+    }
+    if (optimize) {
+        ProgramOptimizer optimizer(program);
+        const std::vector<Instruction> &optimized = optimizer.getProgram();
+        std::copy(optimized.begin(), optimized.end(),
+                  prepared.optimizedProgram);
+        program = prepared.optimizedProgram;
+        if (!characterClasses)
+            prepared.plainProgram = program;
+    }
+
+    prepared.decoded.decode(program, prepared.classes);
+    if (usePrefilter)
+        buildPrefilter(prepared);
+    if (mode == BIT_PARALLEL)
+        prepared.tables = BitParallelNFA::Tables(prepared.decoded);
+    if (mode == JIT)
+        prepared.compiled = JitVM::load(prepared.plainProgram);
+    prepared.memory = sizeof(PreparedProgram) +
+                      prepared.classes.capacity() * sizeof(CharacterClass) +
+                      prepared.tables.getMemoryUsed();
+}
+
+void CiceroMulti::buildPrefilter(PreparedProgram &prepared) const {
+    prepared.prefilter = Prefilter(ProgramAnalysis(prepared.plainProgram));
+    prepared.hasPrefilter = true;
+}
+
+void CiceroMulti::reserveCaches(PreparedProgram &prepared) const {
+    size_t slots = workers.size() + 1;
+    if ((mode == LAZY_DFA || mode == BIT_PARALLEL) &&
+        prepared.dfaCaches.size() < slots)
+        prepared.dfaCaches.resize(slots);
+}
+
+CiceroMulti::PreparedProgram &
+CiceroMulti::prepare(const Instruction *program) {
+    bool added;
+    PreparedProgram &prepared = findPrepared(program, added);
+    if (added) {
+        build(prepared);
+        memoryUsed += prepared.memory;
+    }
+    reserveCaches(prepared);
+    return prepared;
+}
+
+void CiceroMulti::accountStates() {
+    if (current == nullptr || current->dfaCaches.size() <= cacheSlot)
+        return;
+    // Wraps around when the cache was flushed, as the sums then should.
+    size_t used = current->dfaCaches[cacheSlot].memoryUsed;
+    owner->memoryUsed += used - accountedStates;
+    stateMemory += used - accountedStates;
+    accountedStates = used;
+}
+
+// Only touches the caches of this object, which the others never use.
+void CiceroMulti::dropStates() {
+    auto drop = [&](PreparedProgram &prepared) {
+        if (prepared.dfaCaches.size() > cacheSlot)
+            prepared.dfaCaches[cacheSlot] = LazyDFA::Cache();
+    };
+    for (auto &entry : owner->prepared) {
+        drop(*entry.second);
+    }
+    if (owner->loaded)
+        drop(*owner->loaded);
+    owner->memoryUsed -= stateMemory;
+    stateMemory = 0;
+    accountedStates = 0;
+}
+
+void CiceroMulti::trimPrepared() {
+    accountStates();
+    for (auto &worker : workers) {
+        worker->accountStates();
+    }
+    if (memoryUsed <= memoryLimit / 2)
+        return;
+
+    std::unique_ptr<PreparedProgram> kept;
+    for (auto &entry : prepared) {
+        if (entry.second.get() == current)
+            kept = std::move(entry.second);
+    }
+    prepared.clear();
+    bundlePrograms.clear();
+
+    memoryUsed = 0;
+    stateMemory = 0;
+    accountedStates = 0;
+    for (auto &worker : workers) {
+        worker->current = nullptr;
+        worker->stateMemory = 0;
+        worker->accountedStates = 0;
+    }
+    for (PreparedProgram *program : {kept.get(), loaded.get()}) {
+        if (program == nullptr)
+            continue;
+        for (auto &cache : program->dfaCaches) {
+            cache = LazyDFA::Cache();
+        }
+        memoryUsed += program->memory;
+    }
+    if (kept) {
+        uint64_t hash = kept->hash;
+        prepared.emplace(hash, std::move(kept));
+    }
+    // Back to its start state.
+    if (current != nullptr)
+        bindProgram(*current);
+}
+
+void CiceroMulti::applyMemoryLimit() {
+    size_t share = std::min(LazyDFA::DEFAULT_MEMORY_LIMIT,
+                            memoryLimit / 2 / (workers.size() + 1));
+    for (size_t i = 0; i <= workers.size(); i++) {
+        CiceroMulti &cicero = i == 0 ? *this : *workers[i - 1];
+        if (cicero.dfa)
+            cicero.dfa->setMemoryLimit(share);
+        if (cicero.bitNFA)
+            cicero.bitNFA->setMemoryLimit(share);
+    }
+}
+
+void CiceroMulti::dropPrepared() {
+    // The one set may be about to go.
+    if (current != nullptr && current != loaded.get())
+        std::copy(current->source, current->source + INSTR_MEM_SIZE, program);
+
+    prepared.clear();
+    bundlePrograms.clear();
+    loaded.reset();
+    current = nullptr;
+    memoryUsed = 0;
+    stateMemory = 0;
+    accountedStates = 0;
+    for (auto &worker : workers) {
+        worker->current = nullptr;
+        worker->stateMemory = 0;
+        worker->accountedStates = 0;
+    }
+    if (hasProgram)
+        bindLoaded();
+}
+
+// The file may have changed since it was last set, so nothing is kept from
+// then.
+void CiceroMulti::bindLoaded() {
+    if (loaded) {
+        // Its states go with it.
+        accountStates();
+        size_t states = loaded->dfaCaches.empty()
+                            ? 0
+                            : loaded->dfaCaches[0].memoryUsed;
+        memoryUsed -= loaded->memory + states;
+        stateMemory -= states;
+        if (current == loaded.get())
+            current = nullptr;
+    }
+    loaded = std::make_unique<PreparedProgram>();
+    std::copy(program, program + INSTR_MEM_SIZE, loaded->source);
+    build(*loaded);
+    memoryUsed += loaded->memory;
+    reserveCaches(*loaded);
+    bindProgram(*loaded);
+}
+
+// Only points the engines at what was prepared, analyzing it for the
+// prefilter if that was turned on since: the lazy DFA resumes the states it
+// discovered for the program, if it ran it before.
+void CiceroMulti::bindProgram(PreparedProgram &prepared) {
+    accountStates();
+    if (owner->memoryUsed > owner->memoryLimit / 2)
+        dropStates();
+    if (usePrefilter && !prepared.hasPrefilter)
+        buildPrefilter(prepared);
+    current = &prepared;
+    accountedStates = prepared.dfaCaches.size() > cacheSlot
+                          ? prepared.dfaCaches[cacheSlot].memoryUsed
+                          : 0;
+    const DecodedProgram &decoded = prepared.decoded;
+    engine->setProgram(decoded);
+    if (statsEngine)
+        statsEngine->setProgram(decoded);
+    if (traceEngine)
+        traceEngine->setProgram(decoded);
+    pikeVM->setProgram(decoded);
+    if (dfa)
+        dfa->setProgram(decoded, prepared.dfaCaches[cacheSlot]);
+    if (bitNFA)
+        bitNFA->setProgram(decoded, prepared.tables,
+                           prepared.dfaCaches[cacheSlot]);
+    if (lockstepVM)
+        lockstepVM->setProgram(decoded);
+    if (jitVM)
+        jitVM->setProgram(decoded, prepared.compiled);
+}
 
 bool CiceroMulti::CiceroMulti::isProgramSet() { return hasProgram; }
 
-bool CiceroMulti::match(std::string input) {
+void CiceroMulti::setPrefilter(bool enabled) {
+    usePrefilter = enabled;
+    if (enabled && current != nullptr && !current->hasPrefilter)
+        buildPrefilter(*current);
+}
+
+void CiceroMulti::setDeduplication(bool enabled) {
+    deduplicate = enabled;
+
+    // The engines are rebuilt in the memory of the old ones.
+    bool tracing = traceEngine != nullptr;
+    engine.reset();
+    traceEngine.reset();
+    statsEngine.reset();
+    arena.reset();
+
+    const DecodedProgram &decoded = current ? current->decoded : unset;
+    engine = arena.make<Engine>(decoded, windowSize + 1, enabled, &arena);
+    if (tracing)
+        traceEngine = arena.make<BasicEngine<TraceProbe>>(
+            decoded, windowSize + 1, enabled, &arena);
+}
+
+void CiceroMulti::setOptimization(bool enabled) {
+    if (optimize == enabled)
+        return;
+    optimize = enabled;
+    dropPrepared();
+}
+
+void CiceroMulti::setMemoryLimit(size_t limit) {
+    memoryLimit = limit;
+    applyMemoryLimit();
+    trimPrepared();
+}
+
+void CiceroMulti::setCharacterClasses(bool enabled) {
+    if (characterClasses == enabled)
+        return;
+    characterClasses = enabled;
+    dropPrepared();
+}
+
+bool CiceroMulti::match(std::string_view input) {
 
     if (!hasProgram) {
         fprintf(stderr,
@@ -70,7 +436,284 @@ bool CiceroMulti::match(std::string input) {
         return false;
     }
 
-    return engine->runMultiChar(std::move(input));
+    prefiltered = usePrefilter && !current->prefilter.mayMatch(input);
+    if (prefiltered)
+        return false;
+
+    switch (mode) {
+    case PIKE_VM:
+        return pikeVM->match(input);
+    case LAZY_DFA:
+        return dfa->match(input);
+    case BIT_PARALLEL:
+        return bitNFA->match(input);
+    case LOCKSTEP:
+        return lockstepVM->match(input);
+    case JIT:
+        return jitVM->match(input);
+    case CYCLE_ACCURATE:
+    default:
+        if (traceEngine)
+            return traceEngine->runMultiChar(input);
+        return engine->runMultiChar(input);
+    }
+}
+
+void CiceroMulti::matchAll(const std::string_view *inputs, size_t count,
+                           unsigned char *results) {
+    matchEach(inputs, count, results);
+}
+
+std::vector<unsigned char>
+CiceroMulti::matchAll(const std::vector<std::string> &inputs) {
+    std::vector<unsigned char> results(inputs.size(), false);
+    matchEach(inputs.data(), inputs.size(), results.data());
+    return results;
+}
+
+std::vector<unsigned char>
+CiceroMulti::matchAll(const std::vector<std::string_view> &inputs) {
+    std::vector<unsigned char> results(inputs.size(), false);
+    matchEach(inputs.data(), inputs.size(), results.data());
+    return results;
+}
+
+template <class Text>
+void CiceroMulti::matchEach(const Text *inputs, size_t count,
+                            unsigned char *results) {
+    if (mode != LOCKSTEP || !hasProgram) {
+        for (size_t i = 0; i < count; i++) {
+            results[i] = match(inputs[i]);
+        }
+        return;
+    }
+
+    lanes.clear();
+    laneInputs.clear();
+    for (size_t i = 0; i < count; i++) {
+        results[i] = false;
+        if (!usePrefilter || current->prefilter.mayMatch(inputs[i])) {
+            lanes.push_back(inputs[i]);
+            laneInputs.push_back(i);
+        }
+    }
+
+    laneResults.resize(lanes.size());
+    lockstepVM->match(lanes.data(), lanes.size(), laneResults.data());
+    for (size_t lane = 0; lane < lanes.size(); lane++) {
+        results[laneInputs[lane]] = laneResults[lane];
+    }
+    prefiltered = false;
+}
+
+size_t CiceroMulti::scan(std::string_view input,
+                         const MatchCallback &onMatch) {
+
+    if (!hasProgram) {
+        fprintf(stderr,
+                "[X] No program is loaded to scan the string with.\n");
+        return 0;
+    }
+
+    prefiltered = usePrefilter && !current->prefilter.mayMatch(input);
+    if (prefiltered)
+        return 0;
+
+    switch (mode) {
+    case PIKE_VM:
+    case LAZY_DFA:
+    case BIT_PARALLEL:
+    case LOCKSTEP:
+    case JIT:
+        return pikeVM->scan(input, onMatch);
+    case CYCLE_ACCURATE:
+    default:
+        if (traceEngine)
+            return traceEngine->scan(input, onMatch);
+        return engine->scan(input, onMatch);
+    }
+}
+
+int CiceroMulti::getClockCycles() const {
+    if (prefiltered)
+        return 0;
+    if (traceEngine)
+        return traceEngine->getClockCycles();
+    return engine->getClockCycles();
+}
+
+bool CiceroMulti::match(std::string_view input, EngineStats &stats) {
+
+    if (!hasProgram) {
+        fprintf(stderr,
+                "[X] No program is loaded to match the string against.\n");
+        return false;
+    }
+
+    if (!statsEngine)
+        statsEngine = arena.make<BasicEngine<StatsProbe>>(
+            current->decoded, windowSize + 1, deduplicate, &arena);
+
+    bool result = statsEngine->runMultiChar(input);
+    stats = statsEngine->getProbe().getStats();
+    return result;
+}
+
+bool CiceroMulti::matchStream(InputStream::Reader reader, size_t chunkSize) {
+
+    streamError = 0;
+    if (!hasProgram) {
+        fprintf(stderr,
+                "[X] No program is loaded to match the stream against.\n");
+        return false;
+    }
+
+    prefiltered = false;
+    InputStream input(std::move(reader), chunkSize);
+    bool result;
+    switch (mode) {
+    case PIKE_VM:
+        result = pikeVM->match(input);
+        break;
+    case LAZY_DFA:
+        result = dfa->match(input);
+        break;
+    case BIT_PARALLEL:
+        result = bitNFA->match(input);
+        break;
+    case LOCKSTEP:
+    case JIT:
+        result = pikeVM->match(input);
+        break;
+    case CYCLE_ACCURATE:
+    default:
+        result = traceEngine ? traceEngine->runStream(input)
+                             : engine->runStream(input);
+        break;
+    }
+
+    // The engines saw the input end where the read failed, so a match may
+    // have been found on a truncated input.
+    streamError = input.getError();
+    if (streamError != 0) {
+        fprintf(stderr, "[X] Could not read the input: %s.\n",
+                strerror(streamError));
+        return false;
+    }
+    return result;
+}
+
+bool CiceroMulti::matchStream(int fd) {
+    return matchStream(InputStream::fromFileDescriptor(fd));
+}
+
+int CiceroMulti::getStreamError() const { return streamError; }
+
+BatchResult CiceroMulti::matchBatch(const std::vector<std::string> &programs,
+                                    const std::vector<std::string> &inputs,
+                                    unsigned threads) {
+    // Every program is loaded once, then only read by the workers.
+    std::vector<Instruction> memory(programs.size() * INSTR_MEM_SIZE);
+    std::vector<const Instruction *> loaded(programs.size(), nullptr);
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (readProgram(programs[i].c_str(), &memory[i * INSTR_MEM_SIZE]))
+            loaded[i] = &memory[i * INSTR_MEM_SIZE];
+    }
+
+    return matchBatch(loaded, inputs, threads);
+}
+
+BatchResult CiceroMulti::matchBatch(const ProgramBundle &bundle,
+                                    const std::vector<std::string> &inputs,
+                                    unsigned threads) {
+    std::vector<const Instruction *> programs;
+    for (size_t i = 0; i < bundle.getProgramCount(); i++) {
+        programs.push_back(bundle.getProgram(i));
+    }
+
+    return matchBatch(programs, inputs, threads);
+}
+
+BatchResult
+CiceroMulti::matchBatch(const std::vector<const Instruction *> &programs,
+                        const std::vector<std::string> &inputs,
+                        unsigned threads) {
+    BatchResult result;
+    result.programCount = programs.size();
+    result.inputCount = inputs.size();
+    result.matches.assign(programs.size() * inputs.size(), false);
+
+    if (!pool || threads != poolThreads) {
+        pool = std::make_unique<ThreadPool>(threads);
+        poolThreads = threads;
+        workers.clear();
+        for (unsigned i = 0; i < pool->getWorkerCount(); i++) {
+            workers.push_back(
+                std::make_unique<CiceroMulti>(windowSize, false, mode));
+            workers.back()->cacheSlot = i + 1;
+            workers.back()->owner = this;
+        }
+        applyMemoryLimit();
+    }
+    trimPrepared();
+
+    // Programs already prepared, by an earlier call or setProgram, are
+    // looked up; the others are prepared in parallel, then kept.
+    std::vector<PreparedProgram *> preparedPrograms(programs.size(),
+                                                    nullptr);
+    std::vector<PreparedProgram *> added;
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (programs[i] == nullptr)
+            continue;
+        bool isNew;
+        preparedPrograms[i] = &findPrepared(programs[i], isNew);
+        reserveCaches(*preparedPrograms[i]);
+        if (isNew)
+            added.push_back(preparedPrograms[i]);
+        else if (usePrefilter && !preparedPrograms[i]->hasPrefilter)
+            buildPrefilter(*preparedPrograms[i]);
+    }
+    pool->run(added.size(),
+              [&](unsigned, size_t program) { build(*added[program]); });
+    for (PreparedProgram *program : added) {
+        memoryUsed += program->memory;
+    }
+
+    // What the workers ran last may be gone, so nothing is bound until a
+    // task binds it. Settings that rebuild the engines are only passed on
+    // when they changed; the programs come prepared with those of this
+    // object.
+    for (auto &worker : workers) {
+        worker->hasProgram = false;
+        worker->current = nullptr;
+        worker->usePrefilter = usePrefilter;
+        if (worker->deduplicate != deduplicate)
+            worker->setDeduplication(deduplicate);
+    }
+    std::vector<size_t> boundProgram(workers.size(), programs.size());
+
+    size_t blocks = (inputs.size() + BATCH_BLOCK - 1) / BATCH_BLOCK;
+
+    pool->run(programs.size() * blocks, [&](unsigned worker, size_t task) {
+        size_t programIndex = task / blocks;
+        if (preparedPrograms[programIndex] == nullptr)
+            return;
+
+        CiceroMulti &cicero = *workers[worker];
+        if (boundProgram[worker] != programIndex) {
+            cicero.bindProgram(*preparedPrograms[programIndex]);
+            cicero.hasProgram = true;
+            boundProgram[worker] = programIndex;
+        }
+
+        size_t first = (task % blocks) * BATCH_BLOCK;
+        size_t last = std::min(first + BATCH_BLOCK, inputs.size());
+        cicero.matchEach(
+            &inputs[first], last - first,
+            &result.matches[programIndex * inputs.size() + first]);
+    });
+
+    return result;
 }
 
 } // namespace Cicero
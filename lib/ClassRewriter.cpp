@@ -0,0 +1,209 @@
+#include "ClassRewriter.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace Cicero {
+
+namespace {
+
+Instruction makeInstruction(unsigned short type, unsigned short data) {
+    return Instruction(type << (BITS_INSTR - BITS_INSTR_TYPE) | data);
+}
+
+} // namespace
+
+ClassRewriter::ClassRewriter(const Instruction *program) {
+    DecodedProgram decoded(program);
+    rewritten.assign(INSTR_MEM_SIZE, Instruction());
+    predecessors.assign(INSTR_MEM_SIZE, std::vector<unsigned short>());
+    rewrittenPCs.assign(INSTR_MEM_SIZE, false);
+
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (!decoded.isReachable(PC))
+            continue;
+        rewritten[PC] = program[PC];
+
+        const DecodedInstruction &instr = decoded[PC];
+        auto leadsTo = [&](unsigned short successor) {
+            if (successor < INSTR_MEM_SIZE)
+                predecessors[successor].push_back(PC);
+        };
+        switch (instr.type) {
+        case SPLIT:
+            leadsTo(instr.target);
+            leadsTo(instr.next);
+            break;
+        case JMP:
+            leadsTo(instr.target);
+            break;
+        case MATCH:
+        case MATCH_ANY:
+        case NOT_MATCH:
+        case MATCH_SET:
+            leadsTo(instr.next);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Classes nested in a larger one are part of it, and come after its
+    // root.
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (!decoded.isReachable(PC) || rewrittenPCs[PC])
+            continue;
+        if (decoded[PC].type == SPLIT)
+            rewriteAlternation(decoded, PC);
+        else if (decoded[PC].type == NOT_MATCH)
+            rewriteNegation(decoded, PC);
+    }
+
+    // Instructions of a class may also be reached from outside of it.
+    DecodedProgram result(rewritten.data());
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (decoded.isReachable(PC) && !result.isReachable(PC))
+            stats.removedInstructions++;
+    }
+}
+
+// The tree holds the SPLIT and JMP reached from root, the MATCH and
+// MATCH_ANY they lead to, and the JMP those go on through. Passing PC 0
+// restarts the match, so it can only be the root. Only root may be reached
+// from outside the tree: a thread entering it elsewhere could go on to
+// root + 1, which becomes the JMP past the class.
+bool ClassRewriter::rewriteAlternation(const DecodedProgram &program,
+                                       unsigned short root) {
+    std::vector<bool> isMember(INSTR_MEM_SIZE, false);
+    std::vector<unsigned short> members;
+    std::vector<unsigned short> leaves;
+    std::vector<unsigned short> pending(1, root);
+    while (!pending.empty()) {
+        unsigned short PC = pending.back();
+        pending.pop_back();
+        if (PC >= INSTR_MEM_SIZE || rewrittenPCs[PC] ||
+            (PC == 0 && PC != root))
+            return false;
+        if (isMember[PC])
+            continue;
+        isMember[PC] = true;
+        members.push_back(PC);
+
+        const DecodedInstruction &instr = program[PC];
+        if (instr.type == SPLIT) {
+            pending.push_back(instr.target);
+            pending.push_back(instr.next);
+        } else if (instr.type == JMP) {
+            pending.push_back(instr.target);
+        } else if (instr.type == MATCH || instr.type == MATCH_ANY) {
+            leaves.push_back(PC);
+        } else {
+            return false;
+        }
+    }
+
+    CharacterClass characterClass;
+    unsigned short join = INSTR_MEM_SIZE;
+    for (unsigned short leaf : leaves) {
+        characterClass |= program[leaf].accepted;
+
+        unsigned short PC = program[leaf].next;
+        for (int hops = 0; PC != 0 && PC < INSTR_MEM_SIZE &&
+                           program[PC].type == JMP;
+             hops++) {
+            if (hops == INSTR_MEM_SIZE || rewrittenPCs[PC])
+                return false;
+            if (!isMember[PC]) {
+                isMember[PC] = true;
+                members.push_back(PC);
+            }
+            PC = program[PC].target;
+        }
+        if (leaf != leaves.front() && PC != join)
+            return false;
+        join = PC;
+    }
+    if (join >= INSTR_MEM_SIZE || isMember[join])
+        return false;
+
+    for (unsigned short member : members) {
+        if (member == root)
+            continue;
+        for (unsigned short predecessor : predecessors[member]) {
+            if (!isMember[predecessor])
+                return false;
+        }
+    }
+
+    replace(members, root, characterClass, join);
+    stats.alternations++;
+    return true;
+}
+
+// Only the first NOT_MATCH may be jumped to: the chain is otherwise entered
+// in its middle.
+bool ClassRewriter::rewriteNegation(const DecodedProgram &program,
+                                    unsigned short first) {
+    CharacterClass characterClass;
+    characterClass.set();
+    std::vector<unsigned short> members;
+    unsigned short PC = first;
+    while (PC < INSTR_MEM_SIZE && program[PC].type == NOT_MATCH) {
+        if (rewrittenPCs[PC] ||
+            (PC != first && predecessors[PC].size() != 1))
+            return false;
+        characterClass.reset(program[PC].character);
+        members.push_back(PC);
+        PC = program[PC].next;
+    }
+
+    // A single NOT_MATCH takes as many cycles as the MATCH_SET and its JMP.
+    if (members.size() < 2 || PC >= INSTR_MEM_SIZE ||
+        program[PC].type != MATCH_ANY || rewrittenPCs[PC] ||
+        predecessors[PC].size() != 1 || program[PC].next >= INSTR_MEM_SIZE)
+        return false;
+    members.push_back(PC);
+
+    replace(members, first, characterClass, program[PC].next);
+    stats.negations++;
+    return true;
+}
+
+void ClassRewriter::replace(const std::vector<unsigned short> &members,
+                            unsigned short PC,
+                            const CharacterClass &characterClass,
+                            unsigned short next) {
+    size_t count = characterClass.count();
+    if (count == 256) {
+        rewritten[PC] = makeInstruction(MATCH_ANY, 0);
+    } else if (count == 1) {
+        unsigned short character = 0;
+        while (!characterClass[character])
+            character++;
+        rewritten[PC] = makeInstruction(MATCH, character);
+    } else {
+        auto found = std::find(classes.begin(), classes.end(), characterClass);
+        unsigned short index = found - classes.begin();
+        if (found == classes.end())
+            classes.push_back(characterClass);
+        rewritten[PC] = makeInstruction(MATCH, MATCH_SET_FLAG | index);
+        stats.largestClass = std::max(stats.largestClass, count);
+    }
+    rewritten[PC + 1] = makeInstruction(JMP, next);
+
+    for (unsigned short member : members) {
+        rewrittenPCs[member] = true;
+    }
+}
+
+const std::vector<Instruction> &ClassRewriter::getProgram() const {
+    return rewritten;
+}
+
+const std::vector<CharacterClass> &ClassRewriter::getClasses() const {
+    return classes;
+}
+
+const ClassRewriterStats &ClassRewriter::getStats() const { return stats; }
+
+} // namespace Cicero
@@ -2,19 +2,34 @@
 #include "Const.h"
 #include "Engine.h"
 
+#include "TraceProbe.h"
+
 #include <cstddef>
-#include <cstdio>
-#include <string>
 
 namespace Cicero {
 
-Core::Core(Instruction *p, bool dbg) {
+template <class Probe>
+BasicCore<Probe>::BasicCore(const DecodedInstruction *p) {
     program = p;
-    verbose = dbg;
+    onMatch = nullptr;
     reset();
 }
 
-void Core::reset() {
+template <class Probe>
+void BasicCore<Probe>::setProgram(const DecodedInstruction *p) {
+    program = p;
+}
+
+template <class Probe>
+void BasicCore<Probe>::setMatchCallback(const MatchCallback *callback) {
+    onMatch = callback;
+}
+
+template <class Probe>
+MatchSpan BasicCore<Probe>::getMatch() const { return match; }
+
+template <class Probe>
+void BasicCore<Probe>::reset() {
     accept = false;
     valid = false;
     running = true;
@@ -22,59 +37,76 @@ void Core::reset() {
     pipelineRegister23 = nullptr;
     outStage1 = CoreOUT();
     outStage2 = CoreOUT();
+    startStage1 = 0;
+    startStage2 = 0;
+    match = MatchSpan{0, 0};
+    matchPC = 0;
 }
 
-bool Core::isAccepted() const { return accept; }
-bool Core::isValid() const { return valid; }
-bool Core::isRunning() const { return running; }
+template <class Probe>
+bool BasicCore<Probe>::isAccepted() const { return accept; }
+template <class Probe> bool BasicCore<Probe>::isValid() const { return valid; }
+template <class Probe>
+bool BasicCore<Probe>::isRunning() const { return running; }
 
-bool Core::isStage2Ready() { return pipelineRegister12 != nullptr; }
+template <class Probe>
+bool BasicCore<Probe>::isStage2Ready() { return pipelineRegister12 != nullptr; }
 
-bool Core::isStage3Ready() {
+template <class Probe>
+bool BasicCore<Probe>::isStage3Ready() {
     return pipelineRegister23 != nullptr &&
-           pipelineRegister23->getType() == SPLIT;
+           pipelineRegister23->type == SPLIT;
 }
 
-Instruction *Core::getPipelineRegister12() { return pipelineRegister12; }
-Instruction *Core::getPipelineRegister23() { return pipelineRegister23; }
-CoreOUT Core::getOutStage1() { return outStage1; }
-CoreOUT Core::getOutStage2() { return outStage2; }
+template <class Probe>
+const DecodedInstruction *BasicCore<Probe>::getPipelineRegister12() {
+    return pipelineRegister12;
+}
+template <class Probe>
+const DecodedInstruction *BasicCore<Probe>::getPipelineRegister23() {
+    return pipelineRegister23;
+}
+template <class Probe>
+CoreOUT BasicCore<Probe>::getOutStage1() { return outStage1; }
+template <class Probe>
+CoreOUT BasicCore<Probe>::getOutStage2() { return outStage2; }
 
-void Core::stage1Stall() {
+template <class Probe>
+void BasicCore<Probe>::stage1Stall() {
     // Sets pipelineRegister12 to NULL if
     pipelineRegister12 = nullptr;
+    probe.onStall(1);
 }
 
 // Multichar version
-void Core::stage1(CoreOUT bufferOUT) {
+template <class Probe>
+void BasicCore<Probe>::stage1(CoreOUT bufferOUT, size_t start) {
     pipelineRegister12 = &program[bufferOUT.getPC()];
     outStage1 = bufferOUT;
-    if (verbose) {
-        printf("\t(PC%d)(CC_ID%d)(S1) ", bufferOUT.getPC(),
-               bufferOUT.getCC_ID());
-        pipelineRegister12->printType(bufferOUT.getPC());
-        printf("\n");
-    }
+    startStage1 = start;
+    probe.onFetch(bufferOUT, pipelineRegister12->instruction);
 }
 
-void Core::stage2Stall() { pipelineRegister23 = nullptr; }
+template <class Probe>
+void BasicCore<Probe>::stage2Stall() {
+    pipelineRegister23 = nullptr;
+    probe.onStall(2);
+}
 
-CoreOUT Core::stage2(CoreOUT sCO12, Instruction *stage12, char currentChar) {
+template <class Probe>
+CoreOUT BasicCore<Probe>::stage2(CoreOUT sCO12,
+                                 const DecodedInstruction *stage12,
+                                 char currentChar) {
     // Stage 2: get next PC and handle ACCEPT
-    pipelineRegister23 = stage12->getType() == SPLIT ? stage12 : nullptr;
+    pipelineRegister23 = stage12->type == SPLIT ? stage12 : nullptr;
     outStage2 = sCO12;
+    probe.onExecute(sCO12, stage12->instruction, currentChar);
     CoreOUT newPC;
     running = true;
     accept = false;
     valid = false;
 
-    if (verbose) {
-        printf("\t(PC%d)(CC_ID%d)(S2) ", sCO12.getPC(), sCO12.getCC_ID());
-        stage12->printType(sCO12.getPC());
-        printf("\n");
-    }
-
-    switch (stage12->getType()) {
+    switch (stage12->type) {
 
     case ACCEPT:
         if (currentChar == '\0')
@@ -84,29 +116,22 @@ CoreOUT Core::stage2(CoreOUT sCO12, Instruction *stage12, char currentChar) {
 
     case SPLIT:
         valid = true;
-        newPC = CoreOUT(sCO12.getPC() + 1, sCO12.getCC_ID());
+        newPC = CoreOUT(stage12->next, sCO12.getCC_ID());
         break;
 
     case MATCH:
-        if (char(stage12->getData()) == currentChar) {
+    case MATCH_SET:
+        if (stage12->accepted[(unsigned char)currentChar]) {
             valid = true;
-            newPC = CoreOUT(sCO12.getPC() + 1, sCO12.getCC_ID() + 1);
-            if (verbose) {
-                printf("\t\tCharacters matched: input %c to %c\n", currentChar,
-                       char(stage12->getData()));
-            }
+            newPC = CoreOUT(stage12->next, sCO12.getCC_ID() + 1);
         } else {
-            if (verbose) {
-                printf("\t\tCharacters not matched: input %c to %c\n",
-                       currentChar, char(stage12->getData()));
-            }
             newPC = CoreOUT();
         }
         break;
 
     case JMP:
         valid = true;
-        newPC = (CoreOUT(stage12->getData(), sCO12.getCC_ID()));
+        newPC = CoreOUT(stage12->target, sCO12.getCC_ID());
         break;
 
     case END_WITHOUT_ACCEPTING:
@@ -116,10 +141,7 @@ CoreOUT Core::stage2(CoreOUT sCO12, Instruction *stage12, char currentChar) {
 
     case MATCH_ANY:
         valid = true;
-        if (verbose) {
-            printf("\t\tCharacters matched: input %c to ANY\n", currentChar);
-        }
-        newPC = (CoreOUT(sCO12.getPC() + 1, (sCO12.getCC_ID() + 1)));
+        newPC = CoreOUT(stage12->next, sCO12.getCC_ID() + 1);
         break;
 
     case ACCEPT_PARTIAL:
@@ -128,36 +150,34 @@ CoreOUT Core::stage2(CoreOUT sCO12, Instruction *stage12, char currentChar) {
         break;
 
     case NOT_MATCH:
-        if (char(stage12->getData()) != currentChar) {
+        if (stage12->accepted[(unsigned char)currentChar]) {
             valid = true;
-            newPC = CoreOUT(sCO12.getPC() + 1, sCO12.getCC_ID());
+            newPC = CoreOUT(stage12->next, sCO12.getCC_ID());
         } else {
             newPC = CoreOUT();
         }
         break;
 
-    default:
-        fprintf(stderr, "[X] Malformed instruction found.");
+    default: // Unreachable, every decoded type is handled.
         newPC = CoreOUT();
         break;
     }
     return newPC;
 }
 
-CoreOUT Core::stage3(CoreOUT sCO23, Instruction *stage23) {
-    if (verbose) {
-        printf("\t(PC%d)(CC_ID%d)(S3)", sCO23.getPC(), sCO23.getCC_ID());
-        stage23->printType(sCO23.getPC() + 1);
-        printf("\n");
-    }
-    CoreOUT newPC = CoreOUT(stage23->getData(), sCO23.getCC_ID());
+template <class Probe>
+CoreOUT BasicCore<Probe>::stage3(CoreOUT sCO23,
+                                 const DecodedInstruction *stage23) {
+    CoreOUT newPC = CoreOUT(stage23->target, sCO23.getCC_ID());
 
     return newPC;
 }
 
-ClockResult Core::runClock(std::string input, int currentWindowIndex,
-                           int currentBufferIndex, int windowSize,
-                           Buffers *buffers) {
+template <class Probe>
+ClockResult BasicCore<Probe>::runClock(const char *window, size_t windowLength,
+                                       size_t windowPosition,
+                                       int currentBufferIndex, int windowSize,
+                                       Buffers *buffers, Buffers *station) {
 
     CoreOUT newPC;
     /* READ
@@ -172,19 +192,18 @@ ClockResult Core::runClock(std::string input, int currentWindowIndex,
     bool stage3Ready = isStage3Ready();
 
     // Save the inter-stage registers for use.
-    Instruction *savedStage12 = getPipelineRegister12();
-    Instruction *savedStage23 = getPipelineRegister23();
+    const DecodedInstruction *savedStage12 = getPipelineRegister12();
+    const DecodedInstruction *savedStage23 = getPipelineRegister23();
     CoreOUT savedOut12 = getOutStage1();
     CoreOUT savedOut23 = getOutStage2();
-
-    if (verbose)
-        printf("\tStages deemed ready: %x, %x, %x\n", stage1Ready, stage2Ready,
-               stage3Ready);
+    size_t savedStart12 = startStage1;
+    size_t savedStart23 = startStage2;
 
     /* EXEC */
     // Stage 1: retrieve newPC from active buffer and load instruction.
     if (stage1Ready) {
-        stage1(buffers->getPC(buffers->getFirstNotEmpty(currentBufferIndex)));
+        unsigned short slot = buffers->getFirstNotEmpty(currentBufferIndex);
+        stage1(buffers->getPC(slot), buffers->getStart(slot));
     } else {
         // Set intermediate registers to zero
         stage1Stall();
@@ -195,30 +214,40 @@ ClockResult Core::runClock(std::string input, int currentWindowIndex,
         // Set intermediate registers to zero
         stage2Stall();
     } else {
-        int inputIndex =
-            currentWindowIndex +
-            Engine::mod((savedOut12.getCC_ID() - currentBufferIndex),
-                        (windowSize));
+        size_t windowOffset = BasicEngine<Probe>::mod(
+            (savedOut12.getCC_ID() - currentBufferIndex), (windowSize));
 
-        if (inputIndex > input.size()) {
+        if (windowOffset > windowLength) {
             // We are out of the string! Do not create a new thread i.e. not add
             // anything to the buffers
+            probe.onDrop(savedOut12);
         } else {
-            newPC = stage2(savedOut12, savedStage12, input[inputIndex]);
+            // Passing PC 0 (re)starts the match at the current character.
+            size_t position = windowPosition + windowOffset;
+            size_t start = savedOut12.getPC() == 0 ? position : savedStart12;
+
+            newPC = stage2(savedOut12, savedStage12,
+                           windowOffset < windowLength ? window[windowOffset]
+                                                       : '\0');
+            startStage2 = start;
 
             // Handle the returned value, if it's a valid one.
             if (isValid()) {
-                if (verbose)
-                    printf("\t\tPushing PC%d to FIFO%d\n", newPC.getPC(),
-                           newPC.getCC_ID() % windowSize);
                 // Push to correct buffer
-                buffers->pushTo(newPC.getCC_ID() % windowSize, newPC.getPC());
+                if (buffers->pushTo(newPC.getCC_ID() % windowSize,
+                                    newPC.getPC(), start))
+                    probe.onPush(*buffers, newPC, 2);
                 // Invalid values that must be handled are returned by ACCEPT,
                 // ACCEPT_PARTIAL and END_WITHOUT_ACCEPTING. Apart from these,
                 // the only way for a computation to end is by reaching end of
                 // string without ACCEPT.
             } else if (isAccepted()) {
-                return ACCEPTED;
+                match = MatchSpan{start, position};
+                matchPC = savedOut12.getPC();
+                probe.onAccept(match);
+                if (onMatch == nullptr)
+                    return ACCEPTED;
+                (*onMatch)(match);
             } else if (!isRunning()) {
                 return REFUSED;
             }
@@ -231,11 +260,13 @@ ClockResult Core::runClock(std::string input, int currentWindowIndex,
 
         newPC = stage3(savedOut23, savedStage23);
 
-        if (verbose)
-            printf("\t\tPushing PC%d to FIFO%x\n", newPC.getPC(),
-                   newPC.getCC_ID() % windowSize);
         // Push to correct buffer
-        buffers->pushTo(newPC.getCC_ID() % windowSize, newPC.getPC());
+        Buffers *target = station != nullptr ? station : buffers;
+        if (target->pushTo(newPC.getCC_ID() % windowSize, newPC.getPC(),
+                           savedStart23))
+            probe.onPush(*target, newPC, 3);
+    } else {
+        probe.onStall(3);
     }
 
     /* WRITEBACK
@@ -245,32 +276,14 @@ ClockResult Core::runClock(std::string input, int currentWindowIndex,
     // from the buffer. Otherwise, it would risk consuming a value added by
     // stage 2 in the same cycle.
     if (stage1Ready) {
-        if (verbose) {
-            int inputIndex =
-                currentWindowIndex +
-                Engine::mod((savedOut12.getCC_ID() - currentBufferIndex),
-                            (windowSize));
-            if (inputIndex < input.size()) {
-                printf(
-                    "\t\tConsumed PC%d from FIFO%d, relating to character %c\n",
-                    getOutStage1().getPC(), getOutStage1().getCC_ID(),
-                    input[inputIndex]);
-            } else {
-                printf("\t\tConsumed PC%d from FIFO%d, but character index was "
-                       "out of input\n",
-                       getOutStage1().getPC(), getOutStage1().getCC_ID());
-            }
-        }
-
         buffers->popPC(getOutStage1().getCC_ID());
-        if (verbose)
-            printf("\t\tNext PC from FIFO%d: %d\n",
-                   buffers->getFirstNotEmpty(currentBufferIndex),
-                   buffers->getPC(buffers->getFirstNotEmpty(currentBufferIndex))
-                       .getPC());
     }
 
     return CONTINUE;
 }
 
+template class BasicCore<NullProbe>;
+template class BasicCore<StatsProbe>;
+template class BasicCore<TraceProbe>;
+
 } // namespace Cicero
@@ -0,0 +1,73 @@
+#include "DecodedProgram.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace Cicero {
+
+DecodedInstruction::DecodedInstruction(Instruction instruction,
+                                       unsigned short PC)
+    : instruction(instruction) {
+    type = instruction.getType();
+    data = instruction.getData();
+    character = data & 0xff;
+    next = PC + 1;
+    target = data;
+
+    switch (type) {
+    case MATCH:
+        accepted.set(character);
+        break;
+    case NOT_MATCH:
+        accepted.set();
+        accepted.reset(character);
+        break;
+    case MATCH_ANY:
+        accepted.set();
+        break;
+    default:
+        break;
+    }
+}
+
+DecodedProgram::DecodedProgram(const Instruction *program,
+                               const std::vector<CharacterClass> &classes) {
+    decode(program, classes);
+}
+
+void DecodedProgram::decode(const Instruction *program,
+                            const std::vector<CharacterClass> &classes) {
+    instructions.assign(INSTR_MEM_SIZE, DecodedInstruction());
+    reachable.assign(INSTR_MEM_SIZE, false);
+    reachableCount = 0;
+    if (program == nullptr)
+        return;
+
+    // Every way a thread moves on, as in Core::stage2 and stage3.
+    std::vector<unsigned short> pending(1, 0);
+    while (!pending.empty()) {
+        unsigned short PC = pending.back();
+        pending.pop_back();
+        if (PC >= INSTR_MEM_SIZE || reachable[PC])
+            continue;
+        reachable[PC] = true;
+        reachableCount++;
+
+        DecodedInstruction &decoded = instructions[PC];
+        decoded = DecodedInstruction(program[PC], PC);
+        if (program[PC].isMatchSet()) {
+            size_t index = decoded.data & ~MATCH_SET_FLAG;
+            decoded.type = MATCH_SET;
+            decoded.accepted =
+                index < classes.size() ? classes[index] : CharacterClass();
+        }
+        if (decoded.type == SPLIT || decoded.type == JMP)
+            pending.push_back(decoded.target);
+        if (decoded.type == SPLIT || decoded.type == MATCH ||
+            decoded.type == MATCH_ANY || decoded.type == NOT_MATCH ||
+            decoded.type == MATCH_SET)
+            pending.push_back(decoded.next);
+    }
+}
+
+} // namespace Cicero
@@ -1,99 +1,296 @@
 #include "Engine.h"
 #include "Buffers.h"
 #include "Instruction.h"
+#include "TraceProbe.h"
 
-#include <cstdio>
+#include <algorithm>
+#include <cstdint>
 #include <memory>
-#include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 namespace Cicero {
 
-Engine::Engine(Instruction *program, unsigned short W, bool dbg) {
-    core = std::make_unique<Core>(program, dbg);
-    buffers = std::make_unique<Buffers>(W);
-    verbose = dbg;
+template <class Probe>
+MatchContext<Probe>::MatchContext(const DecodedProgram &program,
+                                  unsigned short W, bool deduplicate,
+                                  Arena &arena)
+    : core(program.data()),
+      buffers(W, arena, program.getReachableCount(), deduplicate),
+      CCIDBitmap(W, arena) {}
+
+template <class Probe>
+BasicEngine<Probe>::BasicEngine(const Instruction *program, unsigned short W,
+                                bool deduplicate, Arena *arena)
+    : BasicEngine(DecodedProgram(), W, deduplicate, arena) {
+    setProgram(program);
+}
+
+template <class Probe>
+BasicEngine<Probe>::BasicEngine(const DecodedProgram &program,
+                                unsigned short W, bool deduplicate,
+                                Arena *arena) {
+    if (arena == nullptr) {
+        ownArena = std::make_unique<Arena>();
+        arena = ownArena.get();
+    }
+    context = arena->make<MatchContext<Probe>>(program, W, deduplicate,
+                                               *arena);
     windowSize = W;
-    currentBufferIndex = 0;
-    CCIDBitmap = std::vector(windowSize, false);
-}
-
-void Engine::updateBitmap() {
-    // Check buffers
-    for (unsigned short i = 0; i < CCIDBitmap.size(); i++) {
-        CCIDBitmap[i] = (!buffers->isEmpty(i)) |
-                        ((core->getOutStage1().getCC_ID() == i) &
-                         (core->getPipelineRegister12() != nullptr)) |
-                        ((core->getOutStage2().getCC_ID() == i) &
-                         (core->getPipelineRegister23() != nullptr));
+}
+
+template <class Probe>
+void BasicEngine<Probe>::setProgram(const Instruction *program) {
+    decoded.decode(program);
+    setProgram(decoded);
+}
+
+template <class Probe>
+void BasicEngine<Probe>::setProgram(const DecodedProgram &program) {
+    context->core.setProgram(program.data());
+    context->buffers.reserve(program.getReachableCount());
+}
+
+template <class Probe>
+bool BasicEngine<Probe>::isSlotOccupied(unsigned short CC_ID) {
+    BasicCore<Probe> &core = context->core;
+    return (!context->buffers.isEmpty(CC_ID)) |
+           ((core.getOutStage1().getCC_ID() == CC_ID) &
+            (core.getPipelineRegister12() != nullptr)) |
+           ((core.getOutStage2().getCC_ID() == CC_ID) &
+            (core.getPipelineRegister23() != nullptr));
+}
+
+// The buffers keep their occupancy mask as they are pushed and popped, so
+// only the two threads in the pipeline are looked at.
+template <class Probe>
+void BasicEngine<Probe>::markOccupiedSlots(SlotMask &slots) {
+    BasicCore<Probe> &core = context->core;
+    slots.merge(context->buffers.getOccupied());
+    if (core.getPipelineRegister12() != nullptr &&
+        core.getOutStage1().getCC_ID() < windowSize)
+        slots.set(core.getOutStage1().getCC_ID());
+    if (core.getPipelineRegister23() != nullptr &&
+        core.getOutStage2().getCC_ID() < windowSize)
+        slots.set(core.getOutStage2().getCC_ID());
+}
+
+template <class Probe>
+bool BasicEngine<Probe>::isIdle() {
+    return context->buffers.areAllEmpty() && !context->core.isStage2Ready() &&
+           !context->core.isStage3Ready();
+}
+
+template <class Probe>
+bool BasicEngine<Probe>::hasInstructionReady(unsigned short bufferIndex) {
+    return context->buffers.hasInstructionReady(bufferIndex);
+}
+
+template <class Probe>
+void BasicEngine<Probe>::pushThread(CoreOUT thread, size_t start) {
+    context->buffers.pushTo(thread.getCC_ID(), thread.getPC(), start);
+}
+
+template <class Probe>
+ClockResult BasicEngine<Probe>::runCoreClock(size_t windowIndex,
+                                             unsigned short bufferIndex,
+                                             Buffers *station) {
+    MatchContext<Probe> &state = *context;
+    state.currentClockCycle++;
+    state.core.getProbe().onCycle(state.currentClockCycle, windowIndex);
+    if (windowIndex != state.currentWindowIndex) {
+        state.currentWindowIndex = windowIndex;
+        loadWindow();
     }
+    return state.core.runClock(state.window, state.windowLength, windowIndex,
+                               bufferIndex, windowSize, &state.buffers,
+                               station);
+}
+
+template <class Probe>
+int BasicEngine<Probe>::getClockCycles() const {
+    return context->currentClockCycle;
 }
 
-unsigned short Engine::checkBitmap() {
+template <class Probe>
+MatchSpan BasicEngine<Probe>::getMatch() const {
+    return context->core.getMatch();
+}
+
+template <class Probe>
+void BasicEngine<Probe>::updateBitmap() {
+    context->CCIDBitmap.clearAll();
+    markOccupiedSlots(context->CCIDBitmap);
+}
+
+// Number of empty slots from the head of the window, by which it can slide.
+template <class Probe>
+unsigned short BasicEngine<Probe>::checkBitmap() {
+    return context->CCIDBitmap.findFrom(context->currentBufferIndex,
+                                        windowSize);
+}
+
+template <class Probe>
+int BasicEngine<Probe>::mod(int k, int n) {
+    return ((k %= n) < 0) ? k + n : k;
+}
 
-    unsigned short slide = 0;
-    for (unsigned short i = 0; i < windowSize; i++) {
-        if (CCIDBitmap[(currentBufferIndex + i) % windowSize] == 0)
-            slide += 1;
-        else
-            break;
+// Makes the characters of the sliding window resident (a stream is asked for
+// a whole window, so that the core never sees a premature end) and lets the
+// stream drop the characters before it.
+template <class Probe>
+void BasicEngine<Probe>::loadWindow() {
+    MatchContext<Probe> &state = *context;
+    size_t index = state.currentWindowIndex;
+    if (state.stream != nullptr) {
+        state.windowLength = state.stream->request(index, windowSize);
+        state.stream->release(index);
+        state.window =
+            state.windowLength > 0 ? state.stream->at(index) : nullptr;
+        state.isPastEnd = state.stream->isPastEnd(index);
+    } else {
+        state.isPastEnd = state.input.size() < index;
+        state.windowLength = state.isPastEnd ? 0 : state.input.size() - index;
+        state.window = state.input.data() + (state.isPastEnd ? 0 : index);
     }
-    return slide;
 }
 
-int Engine::mod(int k, int n) { return ((k %= n) < 0) ? k + n : k; }
+template <class Probe>
+void BasicEngine<Probe>::reset(std::string_view newInput,
+                               bool loadFirstThread) {
+    context->input = newInput;
+    context->stream = nullptr;
+    restart(loadFirstThread);
+}
 
-void Engine::reset(std::string newInput) {
-    input = std::move(newInput);
+template <class Probe>
+void BasicEngine<Probe>::reset(InputStream &newStream,
+                               bool loadFirstThread) {
+    context->input = std::string_view();
+    context->stream = &newStream;
+    restart(loadFirstThread);
+}
 
-    currentWindowIndex = 0;
-    currentBufferIndex = 0;
-    currentClockCycle = 0;
+template <class Probe>
+void BasicEngine<Probe>::restart(bool loadFirstThread) {
+    MatchContext<Probe> &state = *context;
+    state.currentWindowIndex = 0;
+    state.currentBufferIndex = 0;
+    state.currentClockCycle = 0;
 
-    core->reset();
-    buffers->flush();
+    state.core.reset();
+    state.core.getProbe().onStart(windowSize);
+    state.buffers.flush();
 
     // Load first instruction PC.
-    buffers->pushTo(0, 0);
+    if (loadFirstThread)
+        state.buffers.pushTo(0, 0, 0);
 
-    CCIDBitmap[0] = true;
-    for (int i = 1; i < windowSize; i++) {
-        CCIDBitmap[i] = false;
-    }
+    state.CCIDBitmap.clearAll();
+    if (loadFirstThread)
+        state.CCIDBitmap.set(0);
+
+    loadWindow();
 }
 
-bool Engine::runMultiChar(std::string _input) {
+template <class Probe>
+bool BasicEngine<Probe>::runMultiChar(std::string_view _input) {
 
     reset(_input);
 
-    if (verbose)
-        printf("\nInitiating match of string %s\n", input.c_str());
+    return run();
+}
 
-    // Simulate clock cycle
-    while (core->isRunning()) {
-        switch (runClock()) {
-        case CONTINUE:
-            break;
-        case ACCEPTED:
-            return true;
-        case REFUSED:
-            return false;
+template <class Probe>
+bool BasicEngine<Probe>::runStream(InputStream &_stream) {
+
+    reset(_stream);
+
+    return run();
+}
+
+template <class Probe>
+size_t BasicEngine<Probe>::scan(std::string_view _input,
+                                const MatchCallback &onMatch) {
+
+    reset(_input);
+
+    // The core runs the threads of the window in no particular order and
+    // does not merge those on the same PC, so one accepting instruction can
+    // be reached at the same end by several threads. The PikeVM keeps only
+    // the most recently started of them, as the `.*` loop comes first.
+    struct Accepted {
+        size_t end;
+        unsigned short PC;
+        size_t start;
+    };
+    std::vector<Accepted> pending;
+    MatchCallback collect = [&](const MatchSpan &span) {
+        unsigned short PC = context->core.getMatchPC();
+        for (auto &accepted : pending) {
+            if (accepted.end == span.end && accepted.PC == PC) {
+                accepted.start = std::max(accepted.start, span.start);
+                return;
+            }
         }
+        pending.push_back(Accepted{span.end, PC, span.start});
+    };
+
+    // Threads only accept within the window, so the ends before it are
+    // final.
+    size_t count = 0;
+    auto report = [&](size_t before) {
+        size_t kept = 0;
+        for (auto &accepted : pending) {
+            if (accepted.end < before) {
+                count++;
+                onMatch(MatchSpan{accepted.start, accepted.end});
+            } else {
+                pending[kept++] = accepted;
+            }
+        }
+        pending.resize(kept);
+    };
+
+    // The core drops accepting threads instead of stopping, so the run only
+    // ends with the input or with END_WITHOUT_ACCEPTING.
+    context->core.setMatchCallback(&collect);
+    ClockResult result = CONTINUE;
+    while (context->core.isRunning() && result == CONTINUE) {
+        result = runClock();
+        report(context->currentWindowIndex);
     }
+    context->core.setMatchCallback(nullptr);
+    context->core.getProbe().onFinish(false);
+    report(SIZE_MAX);
 
-    return false;
+    return count;
 }
 
-ClockResult Engine::runClock() {
-    currentClockCycle++;
+template <class Probe>
+bool BasicEngine<Probe>::run() {
+    ClockResult result = CONTINUE;
+
+    // Simulate clock cycle
+    while (context->core.isRunning() && result == CONTINUE) {
+        result = runClock();
+    }
+
+    context->core.getProbe().onFinish(result == ACCEPTED);
+    return result == ACCEPTED;
+}
 
-    if (verbose)
-        printf("[CC%d] Window first character: %c\n", currentClockCycle,
-               input[currentWindowIndex]);
+template <class Probe>
+ClockResult BasicEngine<Probe>::runClock() {
+    MatchContext<Probe> &state = *context;
+    state.currentClockCycle++;
+    state.core.getProbe().onCycle(state.currentClockCycle,
+                                  state.currentWindowIndex);
 
-    ClockResult coreResult =
-        core->runClock(input, currentWindowIndex, currentBufferIndex,
-                       windowSize, buffers.get());
+    ClockResult coreResult = state.core.runClock(
+        state.window, state.windowLength, state.currentWindowIndex,
+        state.currentBufferIndex, windowSize, &state.buffers);
 
     // We have already accepted/refused, early quit.
     if (coreResult != CONTINUE) {
@@ -102,31 +299,31 @@ ClockResult Engine::runClock() {
 
     updateBitmap();
 
-    if (checkBitmap() != 0) { // Conditions for sliding the window.
+    unsigned short slide = checkBitmap();
+    if (slide != 0) { // Conditions for sliding the window.
 
-        currentWindowIndex += checkBitmap(); // Move the window + i
-        if (verbose) {
-            if (currentWindowIndex < input.size()) {
-                printf("\t\t%x Threads are inactive, sliding window. New "
-                       "first char in window: %c\n",
-                       checkBitmap(), input[currentWindowIndex]);
-            } else {
-                printf("\t\t%x Threads are inactive, sliding window. New "
-                       "window index is out of bounds.\n",
-                       checkBitmap());
-            }
-        }
-        currentBufferIndex = (currentBufferIndex + checkBitmap()) % windowSize;
+        state.currentWindowIndex += slide; // Move the window + i
+        loadWindow();
+        state.core.getProbe().onSlide(slide, state.currentWindowIndex);
+        state.buffers.slide(state.currentBufferIndex, slide);
+        state.currentBufferIndex =
+            (state.currentBufferIndex + slide) % windowSize;
     }
 
     // End the cycle AFTER having processed the '\0' (which can be consumed
     // by an ACCEPT) or if no more instructions are left to be processed.
-    if (input.size() < currentWindowIndex ||
-        (buffers->areAllEmpty() && !core->isStage2Ready() &&
-         !core->isStage3Ready()))
+    if (state.isPastEnd || isIdle())
         return REFUSED;
 
     return CONTINUE;
 }
 
+template struct MatchContext<NullProbe>;
+template struct MatchContext<StatsProbe>;
+template struct MatchContext<TraceProbe>;
+
+template class CICERO_API BasicEngine<NullProbe>;
+template class CICERO_API BasicEngine<StatsProbe>;
+template class CICERO_API BasicEngine<TraceProbe>;
+
 } // namespace Cicero
@@ -0,0 +1,83 @@
+#include "InputStream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace Cicero {
+
+InputStream::InputStream(Reader reader, size_t chunkSize)
+    : reader(std::move(reader)) {
+    this->chunkSize = chunkSize > 0 ? chunkSize : DEFAULT_CHUNK_SIZE;
+    buffer = std::vector<char>(this->chunkSize);
+    bufferStart = 0;
+    buffered = 0;
+    releasedUpTo = 0;
+    ended = false;
+    error = 0;
+}
+
+InputStream::Reader InputStream::fromFileDescriptor(int fd) {
+    return [fd](char *buffer, size_t capacity) -> size_t {
+        while (true) {
+            ssize_t count = read(fd, buffer, capacity);
+            if (count >= 0)
+                return count;
+            if (errno != EINTR)
+                return READ_ERROR;
+        }
+    };
+}
+
+// Drops the released characters and reads the next chunk after the buffered
+// ones, growing the buffer only if it is full of unreleased characters.
+void InputStream::readChunk() {
+    size_t drop = std::min(releasedUpTo - std::min(releasedUpTo, bufferStart),
+                           buffered);
+    if (drop > 0) {
+        memmove(buffer.data(), buffer.data() + drop, buffered - drop);
+        bufferStart += drop;
+        buffered -= drop;
+    }
+
+    if (buffered == buffer.size())
+        buffer.resize(buffer.size() + chunkSize);
+
+    size_t count =
+        reader(buffer.data() + buffered,
+               std::min(chunkSize, buffer.size() - buffered));
+    if (count == READ_ERROR) {
+        error = errno != 0 ? errno : EIO;
+        count = 0;
+    }
+    if (count == 0)
+        ended = true;
+    buffered += count;
+}
+
+size_t InputStream::request(size_t position, size_t count) {
+    while (!ended && bufferStart + buffered < position + count) {
+        readChunk();
+    }
+
+    size_t end = bufferStart + buffered;
+    return end > position ? end - position : 0;
+}
+
+const char *InputStream::at(size_t position) const {
+    return buffer.data() + (position - bufferStart);
+}
+
+void InputStream::release(size_t position) {
+    releasedUpTo = std::max(releasedUpTo, position);
+}
+
+bool InputStream::isPastEnd(size_t position) {
+    request(position, 1);
+    return ended && position > bufferStart + buffered;
+}
+
+int InputStream::getError() const { return error; }
+
+} // namespace Cicero
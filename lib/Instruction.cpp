@@ -6,18 +6,7 @@
 
 namespace Cicero {
 
-Instruction::Instruction() { instr = 0; }
-
-Instruction::Instruction(unsigned short instruction) { instr = instruction; }
-
-unsigned short Instruction::getType() {
-    return instr >> (BITS_INSTR - BITS_INSTR_TYPE);
-};
-unsigned short Instruction::getData() {
-    return instr % (1 << (BITS_INSTR - BITS_INSTR_TYPE));
-};
-
-void Instruction::printType(int PC) {
+void Instruction::printType(int PC) const {
     switch (this->getType()) {
     case 0:
         printf("ACCEPT");
@@ -26,7 +15,10 @@ void Instruction::printType(int PC) {
         printf("SPLIT{%d,%d}", PC + 1, this->getData());
         break;
     case 2:
-        printf("MATCH(%c)", this->getData());
+        if (isMatchSet())
+            printf("MATCH_SET[%d]", this->getData() & ~MATCH_SET_FLAG);
+        else
+            printf("MATCH(%c)", this->getData());
         break;
     case 3:
         printf("JMP(%d)", this->getData());
@@ -49,7 +41,7 @@ void Instruction::printType(int PC) {
     }
 }
 
-void Instruction::print(int pc) {
+void Instruction::print(int pc) const {
     printf("%03d: %x \\\\ ", pc, instr);
     switch (this->getType()) {
     case 0:
@@ -59,7 +51,11 @@ void Instruction::print(int pc) {
         printf("SPLIT\t {%d,%d} \n", pc + 1, this->getData());
         break;
     case 2:
-        printf("MATCH\t char %c\n", this->getData());
+        if (isMatchSet())
+            printf("MATCH_SET\t class %d\n",
+                   this->getData() & ~MATCH_SET_FLAG);
+        else
+            printf("MATCH\t char %c\n", this->getData());
         break;
     case 3:
         printf("JMP to \t %d \n", this->getData());
@@ -0,0 +1,331 @@
+#include "JitVM.h"
+#include "ProgramOptimizer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef CICERO_JIT_COMPILER
+#define CICERO_JIT_COMPILER "c++"
+#endif
+
+namespace Cicero {
+
+namespace {
+
+// Part of the hash, so that programs compiled by an older generator are not
+// loaded from the cache.
+const uint64_t GENERATOR_VERSION = 1;
+
+const char *const ENTRY_POINT = "cicero_jit_match";
+
+std::string jumpTo(unsigned int PC) {
+    if (PC >= INSTR_MEM_SIZE)
+        return "goto pop;";
+    return "goto pc" + std::to_string(PC) + ";";
+}
+
+// Per user, since whatever is in it gets loaded into the process. Empty if
+// there is no home directory to put it in. As the XDG specification asks,
+// an XDG_CACHE_HOME that is not an absolute path is ignored.
+std::string cacheDirectory() {
+    if (const char *directory = getenv("CICERO_JIT_CACHE"))
+        return directory;
+    const char *cache = getenv("XDG_CACHE_HOME");
+    if (cache != nullptr && cache[0] == '/')
+        return std::string(cache) + "/cicero-jit";
+    const char *home = getenv("HOME");
+    if (home != nullptr && home[0] != '\0') {
+        // Created here for users without any cache yet.
+        mkdir((std::string(home) + "/.cache").c_str(), 0700);
+        return std::string(home) + "/.cache/cicero-jit";
+    }
+    return "";
+}
+
+// Another user able to write to the cache could have the process load
+// anything, so it must be a directory of our own that only we can write to,
+// not a link to one.
+bool isPrivate(const std::string &directory) {
+    struct stat status;
+    return lstat(directory.c_str(), &status) == 0 && S_ISDIR(status.st_mode) &&
+           status.st_uid == geteuid() &&
+           (status.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// A single word for the shell, whatever text holds: in single quotes, where
+// only a single quote needs escaping, by closing the quotes around it.
+std::string shellQuote(const std::string &text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+}
+
+JitVM::MatchFunction openShared(const std::string &path) {
+    void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+        return nullptr;
+    // Never closed: the function is shared by every JitVM of the process.
+    return (JitVM::MatchFunction)dlsym(handle, ENTRY_POINT);
+}
+
+} // namespace
+
+JitVM::JitVM(const Instruction *program)
+    : fallback(program), compiled(nullptr) {}
+
+void JitVM::setProgram(const Instruction *program) {
+    fallback.setProgram(program);
+    compiled = load(program);
+}
+
+void JitVM::setProgram(const DecodedProgram &program,
+                       MatchFunction compiled) {
+    fallback.setProgram(program);
+    this->compiled = compiled;
+}
+
+bool JitVM::isCompiled() const { return compiled != nullptr; }
+
+bool JitVM::match(std::string_view input) {
+    if (compiled == nullptr)
+        return fallback.match(input);
+    return compiled(input.data(), input.size());
+}
+
+// FNV-1a over the reachable instructions and their PCs, the only ones the
+// source depends on. Programs of a bundle end where they stop being
+// reachable, so nothing else may be read.
+uint64_t JitVM::hash(const Instruction *program) {
+    return ProgramOptimizer::hashReachable(
+        program, ProgramOptimizer::findReachable(program), GENERATOR_VERSION);
+}
+
+// The threads are followed as by PikeVM::step, in the same priority order,
+// except that a MATCH queues its thread for the next character as soon as
+// it is reached, rather than once the closure is complete; the verdict does
+// not depend on it. No header is included, to keep the compilation short.
+std::string JitVM::generateSource(const Instruction *program) {
+    std::vector<bool> reachable = ProgramOptimizer::findReachable(program);
+    int size = 0;
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (reachable[PC])
+            size = PC + 1;
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line),
+             "// Program %016llx, generated by Cicero::JitVM.\n\n",
+             (unsigned long long)hash(program));
+    std::string source = line;
+    source += "typedef decltype(sizeof 0) size_t;\n"
+              "const int N = " +
+              std::to_string(size) +
+              ";\n\n"
+              "extern \"C\" int " +
+              ENTRY_POINT +
+              "(const char *input, size_t size) {\n"
+              "    unsigned short lists[2][N];\n"
+              "    unsigned short stack[N];\n"
+              "    unsigned int onList[N] = {};\n"
+              "    unsigned int queued[N] = {};\n"
+              "    unsigned int generation = 0;\n"
+              "    unsigned short *entries = lists[0];\n"
+              "    unsigned short *next = lists[1];\n"
+              "    size_t count = 1;\n"
+              "    entries[0] = 0;\n\n"
+              "    for (size_t i = 0; i <= size && count != 0; i++) {\n"
+              "        unsigned char c = i < size ? input[i] : 0;\n"
+              "        if (++generation == 0) {\n"
+              "            for (int PC = 0; PC < N; PC++)\n"
+              "                onList[PC] = queued[PC] = 0;\n"
+              "            generation = 1;\n"
+              "        }\n"
+              "        size_t nextCount = 0;\n\n"
+              "        for (size_t k = 0; k < count; k++) {\n"
+              "            unsigned int PC = entries[k];\n"
+              "            size_t top = 0;\n"
+              "        dispatch:\n"
+              "            switch (PC) {\n";
+    for (int PC = 0; PC < size; PC++) {
+        if (reachable[PC])
+            source += "            case " + std::to_string(PC) + ": " +
+                      jumpTo(PC) + "\n";
+    }
+    source += "            default: goto pop;\n"
+              "            }\n";
+
+    for (int PC = 0; PC < size; PC++) {
+        if (!reachable[PC])
+            continue;
+        std::string label = std::to_string(PC);
+        source += "        pc" + label + ":\n" +
+                  "            if (onList[" + label +
+                  "] == generation) goto pop;\n"
+                  "            onList[" +
+                  label + "] = generation;\n";
+
+        const Instruction &instr = program[PC];
+        std::string data = std::to_string(instr.getData());
+        std::string character = std::to_string((unsigned char)instr.getData());
+        std::string following = std::to_string(PC + 1);
+        std::string queue =
+            PC + 1 < INSTR_MEM_SIZE
+                ? "queued[" + following + "] != generation) {\n" +
+                      "                queued[" + following +
+                      "] = generation;\n"
+                      "                next[nextCount++] = " +
+                      following +
+                      ";\n"
+                      "            }\n"
+                : std::string();
+
+        switch (instr.getType()) {
+        case ACCEPT:
+            source += "            if (c == 0) return 1;\n"
+                      "            goto pop;\n";
+            break;
+        case SPLIT:
+            if (instr.getData() < INSTR_MEM_SIZE)
+                source += "            stack[top++] = " + data + ";\n";
+            source += "            " + jumpTo(PC + 1) + "\n";
+            break;
+        case MATCH:
+            if (!queue.empty())
+                source += "            if (c == " + character + " && " + queue;
+            source += "            goto pop;\n";
+            break;
+        case JMP:
+            source += "            " + jumpTo(instr.getData()) + "\n";
+            break;
+        case END_WITHOUT_ACCEPTING:
+            source += "            return 0;\n";
+            break;
+        case MATCH_ANY:
+            if (!queue.empty())
+                source += "            if (" + queue;
+            source += "            goto pop;\n";
+            break;
+        case ACCEPT_PARTIAL:
+            source += "            return 1;\n";
+            break;
+        case NOT_MATCH:
+            source += "            if (c != " + character + ") " +
+                      jumpTo(PC + 1) +
+                      "\n"
+                      "            goto pop;\n";
+            break;
+        }
+    }
+
+    source += "        pop:\n"
+              "            if (top != 0) {\n"
+              "                PC = stack[--top];\n"
+              "                goto dispatch;\n"
+              "            }\n"
+              "        }\n\n"
+              "        unsigned short *swap = entries;\n"
+              "        entries = next;\n"
+              "        next = swap;\n"
+              "        count = nextCount;\n"
+              "    }\n"
+              "    return 0;\n"
+              "}\n";
+    return source;
+}
+
+// Each program is compiled or loaded by the first JitVM asking for it, while
+// those asking for it at the same time wait for the result.
+JitVM::MatchFunction JitVM::load(const Instruction *program) {
+    static std::mutex mutex;
+    static std::unordered_map<uint64_t, std::shared_future<MatchFunction>>
+        loaded;
+
+    uint64_t key = hash(program);
+    std::unique_lock<std::mutex> lock(mutex);
+    auto found = loaded.find(key);
+    if (found != loaded.end()) {
+        std::shared_future<MatchFunction> function = found->second;
+        lock.unlock();
+        return function.get();
+    }
+
+    std::promise<MatchFunction> promise;
+    loaded.emplace(key, promise.get_future().share());
+    lock.unlock();
+
+    MatchFunction function = compile(program, key);
+    promise.set_value(function);
+    return function;
+}
+
+// The shared object is built under a name of its own, then renamed into
+// the cache, so that processes compiling the same program at once never
+// load a partial one.
+JitVM::MatchFunction JitVM::compile(const Instruction *program,
+                                    uint64_t hash) {
+    std::string directory = cacheDirectory();
+    if (!directory.empty())
+        mkdir(directory.c_str(), 0700);
+    if (directory.empty() || !isPrivate(directory)) {
+        fprintf(stderr,
+                "[X] The JIT cache %s is not a directory only this user can "
+                "write to, matching program %016llx on the PikeVM.\n",
+                directory.empty() ? "($HOME is not set)" : directory.c_str(),
+                (unsigned long long)hash);
+        return nullptr;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx", (unsigned long long)hash);
+    std::string path = directory + name;
+
+    if (access((path + ".so").c_str(), R_OK) == 0) {
+        if (MatchFunction function = openShared(path + ".so"))
+            return function;
+    }
+
+    std::string building = path + "." + std::to_string(getpid());
+    std::ofstream(building + ".cpp") << generateSource(program);
+
+    const char *compiler = getenv("CICERO_JIT_CXX");
+    std::string command =
+        shellQuote(compiler ? compiler : CICERO_JIT_COMPILER) +
+        " -O2 -shared -fPIC -w -o " + shellQuote(building + ".so") + " " +
+        shellQuote(building + ".cpp") + " 2> " + shellQuote(building + ".log");
+    if (std::system(command.c_str()) != 0 ||
+        rename((building + ".so").c_str(), (path + ".so").c_str()) != 0) {
+        fprintf(stderr,
+                "[X] Could not compile program %016llx (see %s.log), "
+                "matching it on the PikeVM.\n",
+                (unsigned long long)hash, building.c_str());
+        remove((building + ".cpp").c_str());
+        remove((building + ".so").c_str());
+        return nullptr;
+    }
+    rename((building + ".cpp").c_str(), (path + ".cpp").c_str());
+    remove((building + ".log").c_str());
+
+    MatchFunction function = openShared(path + ".so");
+    if (function == nullptr)
+        fprintf(stderr, "[X] Could not load %s.so: %s\n", path.c_str(),
+                dlerror());
+    return function;
+}
+
+} // namespace Cicero
@@ -0,0 +1,184 @@
+#include "LazyDFA.h"
+
+#include <string_view>
+#include <vector>
+
+namespace Cicero {
+
+LazyDFA::LazyDFA(const Instruction *program, size_t memoryLimit)
+    : nfa(program), cache(&ownCache) {
+    this->memoryLimit = memoryLimit;
+    reset();
+}
+
+LazyDFA::LazyDFA(const DecodedProgram &program, size_t memoryLimit)
+    : nfa(program), cache(&ownCache) {
+    this->memoryLimit = memoryLimit;
+    reset();
+}
+
+void LazyDFA::reset() {
+    cache->transitions.clear();
+    cache->states.clear();
+    cache->stateIndex.clear();
+    cache->memoryUsed = 0;
+
+    // Start state: a single thread at PC 0. It gets index 0 unless even
+    // that does not fit in the memory limit.
+    addState(std::vector<unsigned short>(1, 0));
+}
+
+void LazyDFA::setMemoryLimit(size_t memoryLimit) {
+    this->memoryLimit = memoryLimit;
+}
+
+void LazyDFA::setProgram(const Instruction *program) {
+    nfa.setProgram(program);
+    cache = &ownCache;
+    reset();
+}
+
+void LazyDFA::setProgram(const DecodedProgram &program) {
+    nfa.setProgram(program);
+    cache = &ownCache;
+    reset();
+}
+
+// A cache without states is new, or its start state did not fit: resetting
+// it again costs nothing.
+void LazyDFA::setProgram(const DecodedProgram &program, Cache &cache) {
+    nfa.setProgram(program);
+    this->cache = &cache;
+    if (cache.states.empty())
+        reset();
+}
+
+// Returns the index of the state for entries, creating it if needed.
+int LazyDFA::addState(const std::vector<unsigned short> &entries) {
+    if (entries.empty())
+        return REFUSING; // No thread left: every input is refused.
+
+    auto found = cache->stateIndex.find(entries);
+    if (found != cache->stateIndex.end())
+        return found->second;
+
+    // Table row, plus the PC list stored both in states and as map key.
+    size_t cost = 256 * sizeof(int) +
+                  2 * (sizeof(entries) +
+                       entries.size() * sizeof(unsigned short)) +
+                  4 * sizeof(void *);
+    if (cache->memoryUsed + cost > memoryLimit)
+        return CACHE_FULL;
+    cache->memoryUsed += cost;
+
+    int index = cache->states.size();
+    cache->states.push_back(entries);
+    cache->stateIndex.emplace(entries, index);
+    cache->transitions.resize(cache->transitions.size() + 256, UNKNOWN);
+    return index;
+}
+
+int LazyDFA::flush() {
+    reset();
+    return addState(nextEntries);
+}
+
+int LazyDFA::computeTransition(int state, unsigned char currentChar) {
+    int next;
+
+    switch (nfa.step(cache->states[state], char(currentChar), nextEntries)) {
+    case ACCEPTED:
+        next = ACCEPTING;
+        break;
+    case REFUSED:
+        next = REFUSING;
+        break;
+    case CONTINUE:
+    default:
+        next = addState(nextEntries);
+        break;
+    }
+
+    if (next != CACHE_FULL)
+        cache->transitions[state * 256 + currentChar] = next;
+    return next;
+}
+
+bool LazyDFA::match(std::string_view input) {
+    Cache &cache = *this->cache;
+    if (cache.states.empty())
+        return nfa.match(input);
+
+    // The character following the input is '\0'.
+    size_t size = input.size();
+    int state = 0;
+
+    for (size_t i = 0; i <= size; i++) {
+        unsigned char currentChar = i < size ? input[i] : '\0';
+        int next = cache.transitions[state * 256 + currentChar];
+
+        if (next == UNKNOWN) {
+            next = computeTransition(state, currentChar);
+            if (next == CACHE_FULL)
+                next = flush();
+            // The threads of nextEntries wait for the next character.
+            if (next == CACHE_FULL)
+                return i < size && nfa.matchFrom(input, i + 1, nextEntries);
+        }
+
+        if (next < 0)
+            return next == ACCEPTING;
+        state = next;
+    }
+
+    // Threads moving past the terminating '\0' are dropped.
+    return false;
+}
+
+bool LazyDFA::match(InputStream &input) {
+    Cache &cache = *this->cache;
+    if (cache.states.empty())
+        return nfa.match(input);
+
+    int state = 0;
+    size_t position = 0;
+
+    while (true) {
+        // Once the stream has no more characters, its '\0' terminator is
+        // fed as a chunk of its own.
+        size_t available = input.request(position, 1);
+        const char *chunk = available > 0 ? input.at(position) : "";
+        size_t count = available > 0 ? available : 1;
+
+        for (size_t i = 0; i < count; i++) {
+            unsigned char currentChar = chunk[i];
+            int next = cache.transitions[state * 256 + currentChar];
+
+            if (next == UNKNOWN) {
+                next = computeTransition(state, currentChar);
+                if (next == CACHE_FULL)
+                    next = flush();
+                if (next == CACHE_FULL)
+                    return available > 0 &&
+                           nfa.matchFrom(input, position + i + 1,
+                                         nextEntries);
+            }
+
+            if (next < 0)
+                return next == ACCEPTING;
+            state = next;
+        }
+
+        // Threads moving past the terminating '\0' are dropped.
+        if (available == 0)
+            return false;
+
+        position += available;
+        input.release(position);
+    }
+}
+
+size_t LazyDFA::getStateCount() const { return cache->states.size(); }
+size_t LazyDFA::getMemoryUsed() const { return cache->memoryUsed; }
+
+} // namespace Cicero
@@ -0,0 +1,245 @@
+#include "LockstepVM.h"
+
+#include <algorithm>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Cicero {
+
+LockstepVM::LockstepVM(const Instruction *program)
+    : LockstepVM(DecodedProgram()) {
+    setProgram(program);
+}
+
+LockstepVM::LockstepVM(const DecodedProgram &program)
+    : program(program.data()), fallback(program) {
+    arrived.assign(INSTR_MEM_SIZE, 0);
+    nextArrived.assign(INSTR_MEM_SIZE, 0);
+    followed.assign(INSTR_MEM_SIZE, 0);
+    arrivedPCs.reserve(INSTR_MEM_SIZE);
+    nextPCs.reserve(INSTR_MEM_SIZE);
+    followedPCs.reserve(INSTR_MEM_SIZE);
+    stack.reserve(2 * INSTR_MEM_SIZE);
+    std::fill(std::begin(equalStep), std::end(equalStep), 0);
+    step = 0;
+    setProgram(program);
+}
+
+void LockstepVM::setProgram(const Instruction *program) {
+    decoded.decode(program);
+    setProgram(decoded);
+}
+
+// Only the reachable instructions are decoded, the others read as ACCEPT.
+void LockstepVM::setProgram(const DecodedProgram &program) {
+    this->program = program.data();
+    fallback.setProgram(program);
+
+    lockstep = true;
+    for (int PC = 0; PC < INSTR_MEM_SIZE && this->program != nullptr; PC++) {
+        if (program[PC].type == END_WITHOUT_ACCEPTING)
+            lockstep = false;
+    }
+}
+
+bool LockstepVM::isLockstep() const { return lockstep; }
+
+void LockstepVM::nextStep() {
+    step++;
+    if (step == 0) { // Wrapped around, stale marks could collide.
+        std::fill(std::begin(equalStep), std::end(equalStep), 0);
+        step = 1;
+    }
+}
+
+LockstepVM::LaneMask LockstepVM::lanesEqualTo(unsigned char character) {
+    if (equalStep[character] == step)
+        return equal[character];
+
+    LaneMask lanes = 0;
+#ifdef __SSE2__
+    __m128i needle = _mm_set1_epi8(char(character));
+    for (int lane = 0; lane < LANES; lane += 16) {
+        __m128i chunk = _mm_load_si128((const __m128i *)(characters + lane));
+        lanes |= LaneMask((unsigned int)_mm_movemask_epi8(
+                     _mm_cmpeq_epi8(chunk, needle)))
+                 << lane;
+    }
+#else
+    for (int lane = 0; lane < LANES; lane++) {
+        if (characters[lane] == character)
+            lanes |= LaneMask(1) << lane;
+    }
+#endif
+
+    equal[character] = lanes;
+    equalStep[character] = step;
+    return lanes;
+}
+
+LockstepVM::LaneMask LockstepVM::lanesIn(const CharacterClass &characterClass,
+                                          LaneMask lanes) {
+    LaneMask in = 0;
+    for (; lanes != 0; lanes &= lanes - 1) {
+        int lane = __builtin_ctzll(lanes);
+        if (characterClass[characters[lane]])
+            in |= LaneMask(1) << lane;
+    }
+    return in;
+}
+
+void LockstepVM::queue(unsigned short PC, LaneMask lanes) {
+    if (PC >= INSTR_MEM_SIZE || lanes == 0)
+        return;
+    if (nextArrived[PC] == 0)
+        nextPCs.push_back(PC);
+    nextArrived[PC] |= lanes;
+}
+
+// Same outcomes as PikeVM::step for each lane, END_WITHOUT_ACCEPTING aside.
+// The closure is followed in no particular order, since without it the
+// verdict does not depend on thread priority.
+LockstepVM::LaneMask LockstepVM::advance() {
+    LaneMask accepted = 0;
+
+    for (unsigned short PC : arrivedPCs) {
+        stack.emplace_back(PC, arrived[PC]);
+        arrived[PC] = 0;
+    }
+    arrivedPCs.clear();
+
+    auto push = [&](unsigned int PC, LaneMask lanes) {
+        if (PC < INSTR_MEM_SIZE && lanes != 0)
+            stack.emplace_back(PC, lanes);
+    };
+
+    while (!stack.empty()) {
+        unsigned short PC = stack.back().first;
+        LaneMask lanes = stack.back().second & ~followed[PC];
+        stack.pop_back();
+        if (lanes == 0)
+            continue;
+        if (followed[PC] == 0)
+            followedPCs.push_back(PC);
+        followed[PC] |= lanes;
+
+        const DecodedInstruction &instr = program[PC];
+        switch (instr.type) {
+        case ACCEPT:
+            accepted |= lanes & lanesEqualTo('\0');
+            break;
+        case ACCEPT_PARTIAL:
+            accepted |= lanes;
+            break;
+        case SPLIT:
+            push(instr.target, lanes);
+            push(instr.next, lanes);
+            break;
+        case JMP:
+            push(instr.target, lanes);
+            break;
+        case MATCH:
+            queue(instr.next, lanes & lanesEqualTo(instr.character));
+            break;
+        case MATCH_ANY:
+            queue(instr.next, lanes);
+            break;
+        case MATCH_SET:
+            queue(instr.next, lanesIn(instr.accepted, lanes));
+            break;
+        case NOT_MATCH:
+            push(instr.next, lanes & ~lanesEqualTo(instr.character));
+            break;
+        default: // END_WITHOUT_ACCEPTING, only reached on the fallback.
+            break;
+        }
+    }
+
+    for (unsigned short PC : followedPCs) {
+        followed[PC] = 0;
+    }
+    followedPCs.clear();
+
+    return accepted;
+}
+
+void LockstepVM::match(const std::string_view *inputs, size_t count,
+                       unsigned char *results) {
+    if (!lockstep) {
+        for (size_t i = 0; i < count; i++) {
+            results[i] = fallback.match(inputs[i]);
+        }
+        return;
+    }
+
+    for (size_t first = 0; first < count; first += LANES) {
+        const std::string_view *batch = inputs + first;
+        size_t laneCount = std::min(count - first, size_t(LANES));
+        LaneMask live = laneCount == LANES ? ~LaneMask(0)
+                                           : (LaneMask(1) << laneCount) - 1;
+        LaneMask accepted = 0;
+
+        arrived[0] = live;
+        arrivedPCs.push_back(0);
+
+        for (size_t i = 0; live != 0; i++) {
+            nextStep();
+
+            // The character following each input is '\0'. Lanes reading it
+            // end with this step.
+            LaneMask ending = 0;
+            for (LaneMask lanes = live; lanes != 0; lanes &= lanes - 1) {
+                int lane = __builtin_ctzll(lanes);
+                if (i < batch[lane].size()) {
+                    characters[lane] = batch[lane][i];
+                } else {
+                    characters[lane] = '\0';
+                    ending |= LaneMask(1) << lane;
+                }
+            }
+
+            // Lanes masked off last step may still have threads queued.
+            size_t kept = 0;
+            for (unsigned short PC : arrivedPCs) {
+                arrived[PC] &= live;
+                if (arrived[PC] != 0)
+                    arrivedPCs[kept++] = PC;
+            }
+            arrivedPCs.resize(kept);
+
+            accepted |= advance();
+
+            // Threads moving past the terminating '\0' are dropped.
+            LaneMask waiting = 0;
+            for (unsigned short PC : nextPCs) {
+                waiting |= nextArrived[PC];
+            }
+            live &= waiting & ~accepted & ~ending;
+
+            std::swap(arrived, nextArrived);
+            std::swap(arrivedPCs, nextPCs);
+        }
+
+        for (unsigned short PC : arrivedPCs) {
+            arrived[PC] = 0;
+        }
+        arrivedPCs.clear();
+
+        for (size_t lane = 0; lane < laneCount; lane++) {
+            results[first + lane] = (accepted >> lane) & 1;
+        }
+    }
+}
+
+bool LockstepVM::match(std::string_view input) {
+    unsigned char result;
+    match(&input, 1, &result);
+    return result;
+}
+
+} // namespace Cicero
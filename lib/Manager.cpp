@@ -1,23 +1,105 @@
 #include "Manager.h"
 
+#include <string_view>
+#include <utility>
+
 namespace Cicero {
 
-Manager::Manager(Cicero::Instruction *program, int engineCount,
-                 int windowSize) {
+Manager::Manager(const Cicero::Instruction *program, int engineCount,
+                 int windowSize)
+    : decoded(program),
+      station(windowSize, arena, decoded.getReachableCount()),
+      CCIDBitmap(windowSize, arena) {
+    engines.reserve(engineCount);
     for (int i = 0; i < engineCount; i++) {
-        engines.push_back(Engine(program, windowSize));
+        engines.emplace_back(decoded, windowSize, false, &arena);
     }
+    this->windowSize = windowSize;
+    currentClockCycle = 0;
 }
 
-bool Manager::match(std::string input) {
+void Manager::setProgram(const Instruction *program) {
+    decoded.decode(program);
+    station.reserve(decoded.getReachableCount());
     for (auto &engine : engines) {
-        engine.reset(input);
+        engine.setProgram(decoded);
     }
+}
+
+void Manager::dispatch() {
+    for (auto &engine : engines) {
+        if (engine.hasInstructionReady(currentBufferIndex))
+            continue;
 
-    for (int engineIndex = 0; engineIndex < engines.size(); engineIndex++) {
-        // TODO: Run a cycle, get the output of that cycle and put it in the
-        // Station
+        unsigned short slot = station.getFirstNotEmpty(currentBufferIndex);
+        if (slot == windowSize) // Nothing left to hand out.
+            return;
+
+        size_t start = station.getStart(slot);
+        engine.pushThread(station.popPC(slot), start);
     }
 }
 
-} // namespace Cicero
\ No newline at end of file
+void Manager::updateBitmap() {
+    CCIDBitmap.clearAll();
+    CCIDBitmap.merge(station.getOccupied());
+    for (auto &engine : engines) {
+        engine.markOccupiedSlots(CCIDBitmap);
+    }
+}
+
+unsigned short Manager::checkBitmap() {
+    return CCIDBitmap.findFrom(currentBufferIndex, windowSize);
+}
+
+bool Manager::match(std::string_view input) {
+    this->input = input;
+
+    // Only the first engine starts with a thread, the others get theirs
+    // from the station.
+    for (int e = 0; e < engines.size(); e++) {
+        engines[e].reset(this->input, e == 0);
+    }
+    station.flush();
+
+    currentWindowIndex = 0;
+    currentBufferIndex = 0;
+    currentClockCycle = 0;
+
+    while (true) {
+        currentClockCycle++;
+
+        dispatch();
+
+        // Engines run in parallel: all of them execute this cycle, and the
+        // verdict of the lowest-numbered one wins.
+        ClockResult result = CONTINUE;
+        for (auto &engine : engines) {
+            ClockResult engineResult = engine.runCoreClock(
+                currentWindowIndex, currentBufferIndex, &station);
+            if (result == CONTINUE)
+                result = engineResult;
+        }
+
+        if (result != CONTINUE)
+            return result == ACCEPTED;
+
+        updateBitmap();
+
+        unsigned short slide = checkBitmap();
+        currentWindowIndex += slide;
+        currentBufferIndex = (currentBufferIndex + slide) % windowSize;
+
+        // Same end conditions as Engine::runClock, over all the engines.
+        bool idle = station.areAllEmpty();
+        for (int e = 0; e < engines.size() && idle; e++) {
+            idle = engines[e].isIdle();
+        }
+        if (this->input.size() < currentWindowIndex || idle)
+            return false;
+    }
+}
+
+int Manager::getClockCycles() const { return currentClockCycle; }
+
+} // namespace Cicero
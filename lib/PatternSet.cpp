@@ -0,0 +1,284 @@
+#include "PatternSet.h"
+#include "CiceroMulti.h"
+#include "ProgramBundle.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Cicero {
+
+// Patterns that accept or stop are noted instead of ending the match.
+struct PatternSet::Verdicts {
+    PatternSet &set;
+
+    ClockResult accept(uint32_t PC, const MatchSpan &) {
+        set.accepts.push_back(set.program[PC].getData());
+        return CONTINUE;
+    }
+    ClockResult stop(uint32_t PC) {
+        set.stops.push_back(set.owner[PC]);
+        return CONTINUE;
+    }
+};
+
+bool PatternSet::Instructions::isAccepted(Address PC, char currentChar) const {
+    LinkedInstruction instr = program[PC];
+    switch (instr.getType()) {
+    case MATCH:
+        return char(instr.getData()) == currentChar;
+    case NOT_MATCH:
+        return char(instr.getData()) != currentChar;
+    case MATCH_ANY:
+        return true;
+    case MATCH_SET:
+        return classes[instr.getData()][(unsigned char)currentChar];
+    default:
+        return false;
+    }
+}
+
+PatternSet::PatternSet() {
+    startNext = std::vector<std::vector<uint32_t>>(256);
+    startAccepts = std::vector<std::vector<uint32_t>>(256);
+    linked = true;
+    loopCount = 0;
+    running = 0;
+}
+
+bool PatternSet::add(const Instruction *instructions, size_t length,
+                     const std::vector<CharacterClass> &classes) {
+    if (!ProgramBundle::isValidProgram(instructions, length)) {
+        fprintf(stderr, "[X] Program %zu is malformed or reaches outside of "
+                        "itself, not adding it to the pattern set.\n",
+                entries.size());
+        return false;
+    }
+    if (program.size() + length >= (1u << LinkedInstruction::BITS_DATA)) {
+        fprintf(stderr, "[X] Pattern set instruction space exceeded.\n");
+        return false;
+    }
+
+    uint32_t base = program.size();
+    uint32_t tag = entries.size();
+    uint32_t classBase = this->classes.size();
+    this->classes.insert(this->classes.end(), classes.begin(), classes.end());
+
+    for (size_t PC = 0; PC < length; PC++) {
+        unsigned short type = instructions[PC].getType();
+        uint32_t data = instructions[PC].getData();
+
+        if (instructions[PC].isMatchSet()) {
+            // Past the end of the table, the class is empty.
+            type = MATCH_SET;
+            data &= ~MATCH_SET_FLAG;
+            if (data >= classes.size()) {
+                data = this->classes.size() - classBase;
+                this->classes.emplace_back();
+            }
+            data += classBase;
+        }
+
+        switch (type) {
+        case SPLIT:
+        case JMP:
+            data += base;
+            break;
+        case ACCEPT:
+        case ACCEPT_PARTIAL:
+            data = tag;
+            break;
+        default:
+            break;
+        }
+
+        program.emplace_back(type, data);
+        owner.push_back(tag);
+    }
+    entries.push_back(base);
+
+    linked = false;
+    return true;
+}
+
+bool PatternSet::add(const char *filename) {
+    Instruction instructions[INSTR_MEM_SIZE];
+    size_t length;
+    return CiceroMulti::readProgram(filename, instructions, false, &length) &&
+           add(instructions, length);
+}
+
+size_t PatternSet::getPatternCount() const { return entries.size(); }
+size_t PatternSet::getInstructionCount() const { return program.size(); }
+
+// The MATCH_ANY of the `.*` loop of the pattern starting at entry: reached
+// from it through SPLIT and JMP only, and followed by a jump back to it.
+uint32_t PatternSet::findLoop(uint32_t entry) const {
+    std::vector<uint32_t> pending(1, entry);
+    std::vector<uint32_t> visited;
+
+    while (!pending.empty()) {
+        uint32_t PC = pending.back();
+        pending.pop_back();
+
+        if (std::find(visited.begin(), visited.end(), PC) != visited.end())
+            continue;
+        visited.push_back(PC);
+
+        LinkedInstruction instr = program[PC];
+        switch (instr.getType()) {
+        case SPLIT:
+            pending.push_back(instr.getData());
+            pending.push_back(PC + 1);
+            break;
+        case JMP:
+            pending.push_back(instr.getData());
+            break;
+        case MATCH_ANY:
+            if (program[PC + 1].getType() == JMP &&
+                program[PC + 1].getData() == entry)
+                return PC;
+            break;
+        default:
+            break;
+        }
+    }
+    return NO_PC;
+}
+
+// Sorts the patterns between anchored and looping ones, and runs one step
+// from the entries of the looping ones on every character, leaving out the
+// loops themselves since they only lead back to the entries.
+void PatternSet::link() {
+    threads.resize(program.size());
+    states = std::vector<PatternState>(entries.size(), RUNNING);
+
+    std::vector<uint32_t> loopEntries;
+    std::vector<uint32_t> loopSuccessors;
+    anchoredEntries.clear();
+
+    for (uint32_t pattern = 0; pattern < entries.size(); pattern++) {
+        uint32_t end = pattern + 1 < entries.size() ? entries[pattern + 1]
+                                                    : program.size();
+        bool stops = false;
+        for (uint32_t PC = entries[pattern]; PC < end && !stops; PC++) {
+            stops = program[PC].getType() == END_WITHOUT_ACCEPTING;
+        }
+
+        uint32_t loop = stops ? NO_PC : findLoop(entries[pattern]);
+        if (loop == NO_PC) {
+            anchoredEntries.push_back(entries[pattern]);
+        } else {
+            loopEntries.push_back(entries[pattern]);
+            loopSuccessors.push_back(loop + 1);
+        }
+    }
+    loopCount = loopEntries.size();
+
+    for (int c = 0; c < 256; c++) {
+        char currentChar = char(c);
+
+        threads.clear();
+        next.clear();
+        accepts.clear();
+        for (uint32_t PC : loopSuccessors) {
+            threads.queue(PC);
+        }
+
+        for (uint32_t PC : loopEntries) {
+            addThread(PC, currentChar);
+        }
+        consume(currentChar);
+
+        std::sort(accepts.begin(), accepts.end());
+        accepts.erase(std::unique(accepts.begin(), accepts.end()),
+                      accepts.end());
+        startNext[c] = next;
+        startAccepts[c] = accepts;
+    }
+
+    linked = true;
+}
+
+void PatternSet::finish(uint32_t pattern, PatternState state) {
+    if (states[pattern] == RUNNING) {
+        states[pattern] = state;
+        running--;
+    }
+}
+
+// Follows the epsilon closure of PC, noting the patterns that accept or
+// stop instead of ending the match.
+void PatternSet::addThread(uint32_t PC, char currentChar) {
+    if (states[owner[PC]] != RUNNING)
+        return;
+
+    Verdicts verdicts{*this};
+    threads.addThread(Instructions{program, classes}, PC, 0, currentChar, 0,
+                      verdicts);
+}
+
+// Queues the successors of the threads that consume currentChar.
+void PatternSet::consume(char currentChar) {
+    threads.consume(Instructions{program, classes}, currentChar, next,
+                    nullptr, [&](uint32_t PC) {
+                        return states[owner[PC]] == RUNNING;
+                    });
+}
+
+std::vector<size_t> PatternSet::match(std::string_view input) {
+    if (!linked)
+        link();
+
+    std::fill(states.begin(), states.end(), RUNNING);
+    running = entries.size();
+    current = anchoredEntries;
+
+    // The character following the input is '\0'.
+    for (size_t i = 0; i <= input.size() && running > 0; i++) {
+        if (current.empty() && loopCount == 0)
+            break;
+
+        char currentChar = i < input.size() ? input[i] : '\0';
+        unsigned char c = currentChar;
+
+        threads.clear();
+        next.clear();
+        accepts.clear();
+        stops.clear();
+
+        for (uint32_t PC : current) {
+            addThread(PC, currentChar);
+        }
+
+        for (uint32_t pattern : startAccepts[c]) {
+            finish(pattern, MATCHED);
+        }
+        for (uint32_t pattern : accepts) {
+            finish(pattern, MATCHED);
+        }
+        for (uint32_t pattern : stops) {
+            finish(pattern, STOPPED);
+        }
+
+        consume(currentChar);
+        for (uint32_t PC : startNext[c]) {
+            if (states[owner[PC]] == RUNNING && threads.queue(PC))
+                next.push_back(PC);
+        }
+
+        // Threads moving past the terminating '\0' are dropped.
+        std::swap(current, next);
+    }
+
+    std::vector<size_t> matched;
+    for (size_t pattern = 0; pattern < states.size(); pattern++) {
+        if (states[pattern] == MATCHED)
+            matched.push_back(pattern);
+    }
+    return matched;
+}
+
+} // namespace Cicero
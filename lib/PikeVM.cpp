@@ -0,0 +1,165 @@
+#include "PikeVM.h"
+
+#include <string_view>
+#include <utility>
+
+namespace Cicero {
+
+namespace {
+
+// Accepting threads end the match, unless they are reported to onMatch;
+// END_WITHOUT_ACCEPTING ends it.
+struct Verdict {
+    const MatchCallback *onMatch;
+
+    ClockResult accept(unsigned short, const MatchSpan &span) const {
+        if (onMatch == nullptr)
+            return ACCEPTED;
+        (*onMatch)(span);
+        return CONTINUE;
+    }
+    ClockResult stop(unsigned short) const { return REFUSED; }
+};
+
+} // namespace
+
+PikeVM::PikeVM(const Instruction *program) : PikeVM(DecodedProgram()) {
+    setProgram(program);
+}
+
+PikeVM::PikeVM(const DecodedProgram &program) {
+    this->program = program.data();
+    threads.resize(INSTR_MEM_SIZE);
+    entries.reserve(INSTR_MEM_SIZE);
+    nextEntries.reserve(INSTR_MEM_SIZE);
+    entryStarts.reserve(INSTR_MEM_SIZE);
+    nextStarts.reserve(INSTR_MEM_SIZE);
+    onMatch = nullptr;
+}
+
+void PikeVM::setProgram(const Instruction *program) {
+    decoded.decode(program);
+    this->program = decoded.data();
+}
+
+void PikeVM::setProgram(const DecodedProgram &program) {
+    this->program = program.data();
+}
+
+ClockResult PikeVM::step(const std::vector<unsigned short> &entryPCs,
+                         char currentChar, std::vector<unsigned short> &next) {
+    return advance(entryPCs, nullptr, currentChar, 0, next);
+}
+
+ClockResult PikeVM::advance(const std::vector<unsigned short> &entryPCs,
+                            const size_t *entryPCStarts, char currentChar,
+                            size_t position,
+                            std::vector<unsigned short> &next) {
+    Instructions instructions{program};
+    Verdict verdict{onMatch};
+
+    threads.clear();
+    next.clear();
+    nextStarts.clear();
+
+    for (size_t i = 0; i < entryPCs.size(); i++) {
+        ClockResult result = threads.addThread(
+            instructions, entryPCs[i], entryPCStarts ? entryPCStarts[i] : 0,
+            currentChar, position, verdict);
+        if (result != CONTINUE)
+            return result;
+    }
+
+    threads.consume(instructions, currentChar, next, &nextStarts,
+                    [](unsigned short) { return true; });
+    return CONTINUE;
+}
+
+size_t PikeVM::scan(std::string_view input, const MatchCallback &onMatch) {
+    size_t count = 0;
+    MatchCallback report = [&](const MatchSpan &span) {
+        count++;
+        onMatch(span);
+    };
+    this->onMatch = &report;
+
+    entries.clear();
+    entries.push_back(0);
+    entryStarts.clear();
+    entryStarts.push_back(0);
+
+    // The character following the input is '\0'.
+    for (size_t i = 0; i <= input.size() && !entries.empty(); i++) {
+        char currentChar = i < input.size() ? input[i] : '\0';
+        if (advance(entries, entryStarts.data(), currentChar, i,
+                    nextEntries) != CONTINUE)
+            break; // END_WITHOUT_ACCEPTING
+
+        std::swap(entries, nextEntries);
+        std::swap(entryStarts, nextStarts);
+    }
+
+    this->onMatch = nullptr;
+    return count;
+}
+
+bool PikeVM::match(std::string_view input) {
+    entries.clear();
+    entries.push_back(0);
+    return matchFrom(input, 0, entries);
+}
+
+bool PikeVM::matchFrom(std::string_view input, size_t position,
+                       const std::vector<unsigned short> &entryPCs) {
+    // The character following the input is '\0'.
+    size_t size = input.size();
+
+    if (&entryPCs != &entries)
+        entries = entryPCs;
+
+    for (size_t i = position; i <= size && !entries.empty(); i++) {
+        ClockResult result =
+            step(entries, i < size ? input[i] : '\0', nextEntries);
+        if (result != CONTINUE)
+            return result == ACCEPTED;
+
+        // Threads moving past the terminating '\0' are dropped.
+        std::swap(entries, nextEntries);
+    }
+
+    return false;
+}
+
+bool PikeVM::match(InputStream &input) {
+    entries.clear();
+    entries.push_back(0);
+    return matchFrom(input, 0, entries);
+}
+
+bool PikeVM::matchFrom(InputStream &input, size_t position,
+                       const std::vector<unsigned short> &entryPCs) {
+    if (&entryPCs != &entries)
+        entries = entryPCs;
+
+    // Whatever is resident is consumed at once, then released.
+    size_t available;
+    while ((available = input.request(position, 1)) > 0) {
+        const char *chunk = input.at(position);
+        for (size_t i = 0; i < available; i++) {
+            if (entries.empty())
+                return false;
+
+            ClockResult result = step(entries, chunk[i], nextEntries);
+            if (result != CONTINUE)
+                return result == ACCEPTED;
+            std::swap(entries, nextEntries);
+        }
+        position += available;
+        input.release(position);
+    }
+
+    // Threads moving past the terminating '\0' are dropped.
+    return !entries.empty() && step(entries, '\0', nextEntries) == ACCEPTED;
+}
+
+} // namespace Cicero
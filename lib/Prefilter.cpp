@@ -0,0 +1,223 @@
+#include "Prefilter.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CICERO_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Cicero {
+
+namespace {
+
+bool matchesAt(const char *input, const Factor &classes) {
+    for (size_t i = 0; i < classes.size(); i++) {
+        if (!classes[i].test((unsigned char)input[i]))
+            return false;
+    }
+    return true;
+}
+
+size_t findScalar(const char *input, size_t length, const Factor &classes) {
+    for (size_t i = 0; i + classes.size() <= length; i++) {
+        if (matchesAt(input + i, classes))
+            return i;
+    }
+    return length;
+}
+
+#ifdef CICERO_X86_SIMD
+
+// Class membership of 32 characters at once, as a bitmask: the lower nibble
+// of each picks the entry of the tables, the upper one the bit of the entry.
+__attribute__((target("avx2"))) inline unsigned int
+membersAVX2(__m256i characters, __m256i lower, __m256i upper) {
+    const __m256i bits = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+        8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i low = _mm256_and_si256(characters, nibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(characters, 4), nibble);
+    __m256i entries =
+        _mm256_blendv_epi8(_mm256_shuffle_epi8(lower, low),
+                           _mm256_shuffle_epi8(upper, low), characters);
+    __m256i found = _mm256_and_si256(entries, _mm256_shuffle_epi8(bits, high));
+    return ~_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(found, _mm256_setzero_si256()));
+}
+
+__attribute__((target("avx2"))) inline __m256i
+loadTableAVX2(const unsigned char *table) {
+    return _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)table));
+}
+
+// Candidates are the positions where the first and last classes both
+// match, checked in full by matchesAt.
+__attribute__((target("avx2"))) size_t
+findAVX2(const char *input, size_t length,
+         const Prefilter::CompiledFactor &factor) {
+    const __m256i firstLower = loadTableAVX2(factor.first.lower);
+    const __m256i firstUpper = loadTableAVX2(factor.first.upper);
+    const __m256i lastLower = loadTableAVX2(factor.last.lower);
+    const __m256i lastUpper = loadTableAVX2(factor.last.upper);
+    size_t span = factor.classes.size() - 1;
+
+    size_t i = 0;
+    for (; i + span + 32 <= length; i += 32) {
+        unsigned int candidates =
+            membersAVX2(_mm256_loadu_si256((const __m256i *)(input + i)),
+                        firstLower, firstUpper) &
+            membersAVX2(
+                _mm256_loadu_si256((const __m256i *)(input + i + span)),
+                lastLower, lastUpper);
+        while (candidates != 0) {
+            size_t offset = i + __builtin_ctz(candidates);
+            if (matchesAt(input + offset, factor.classes))
+                return offset;
+            candidates &= candidates - 1;
+        }
+    }
+    return i + findScalar(input + i, length - i, factor.classes);
+}
+
+__attribute__((target("sse4.2"))) inline unsigned int
+membersSSE42(__m128i characters, __m128i lower, __m128i upper) {
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+                                       8, 16, 32, 64, -128);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    __m128i low = _mm_and_si128(characters, nibble);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(characters, 4), nibble);
+    __m128i entries = _mm_blendv_epi8(_mm_shuffle_epi8(lower, low),
+                                      _mm_shuffle_epi8(upper, low),
+                                      characters);
+    __m128i found = _mm_and_si128(entries, _mm_shuffle_epi8(bits, high));
+    return ~_mm_movemask_epi8(_mm_cmpeq_epi8(found, _mm_setzero_si128())) &
+           0xFFFF;
+}
+
+__attribute__((target("sse4.2"))) size_t
+findSSE42(const char *input, size_t length,
+          const Prefilter::CompiledFactor &factor) {
+    const __m128i firstLower =
+        _mm_loadu_si128((const __m128i *)factor.first.lower);
+    const __m128i firstUpper =
+        _mm_loadu_si128((const __m128i *)factor.first.upper);
+    const __m128i lastLower =
+        _mm_loadu_si128((const __m128i *)factor.last.lower);
+    const __m128i lastUpper =
+        _mm_loadu_si128((const __m128i *)factor.last.upper);
+    size_t span = factor.classes.size() - 1;
+
+    size_t i = 0;
+    for (; i + span + 16 <= length; i += 16) {
+        unsigned int candidates =
+            membersSSE42(_mm_loadu_si128((const __m128i *)(input + i)),
+                         firstLower, firstUpper) &
+            membersSSE42(_mm_loadu_si128((const __m128i *)(input + i + span)),
+                         lastLower, lastUpper);
+        while (candidates != 0) {
+            size_t offset = i + __builtin_ctz(candidates);
+            if (matchesAt(input + offset, factor.classes))
+                return offset;
+            candidates &= candidates - 1;
+        }
+    }
+    return i + findScalar(input + i, length - i, factor.classes);
+}
+
+#endif
+
+enum SearchLevel { SCALAR, SSE42, AVX2 };
+
+SearchLevel detectSearchLevel() {
+#ifdef CICERO_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return AVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return SSE42;
+#endif
+    return SCALAR;
+}
+
+const SearchLevel searchLevel = detectSearchLevel();
+
+} // namespace
+
+Prefilter::NibbleTable::NibbleTable(const CharacterClass &characters) {
+    memset(lower, 0, sizeof(lower));
+    memset(upper, 0, sizeof(upper));
+    for (int c = 0; c < 256; c++) {
+        if (characters.test(c)) {
+            unsigned char *table = c < 128 ? lower : upper;
+            table[c & 15] |= 1 << ((c >> 4) & 7);
+        }
+    }
+}
+
+Prefilter::CompiledFactor::CompiledFactor(const Factor &factor)
+    : classes(factor), first(factor.front()), last(factor.back()) {}
+
+Prefilter::Prefilter() {
+    neverMatches = false;
+    anchored = false;
+    filtersFirstCharacters = false;
+}
+
+Prefilter::Prefilter(const ProgramAnalysis &analysis) : Prefilter() {
+    neverMatches = !analysis.canAccept();
+    anchored = analysis.getLoop() == ProgramAnalysis::NO_PC;
+    for (auto &factor : analysis.getRequiredFactors()) {
+        factors.emplace_back(factor);
+    }
+
+    // Without the loop the first characters are only looked for at position
+    // 0, otherwise they are a factor of their own.
+    firstCharacters = analysis.getFirstCharacters();
+    if (!firstCharacters.all() && !neverMatches) {
+        if (anchored)
+            filtersFirstCharacters = true;
+        else
+            factors.emplace_back(Factor(1, firstCharacters));
+    }
+}
+
+bool Prefilter::isSelective() const {
+    return neverMatches || !factors.empty() || filtersFirstCharacters;
+}
+
+size_t Prefilter::find(const char *input, size_t length,
+                       const CompiledFactor &factor) {
+    if (factor.classes.size() > length)
+        return length;
+    switch (searchLevel) {
+#ifdef CICERO_X86_SIMD
+    case AVX2:
+        return findAVX2(input, length, factor);
+    case SSE42:
+        return findSSE42(input, length, factor);
+#endif
+    default:
+        return findScalar(input, length, factor.classes);
+    }
+}
+
+bool Prefilter::mayMatch(const char *input, size_t length) const {
+    if (neverMatches)
+        return false;
+    if (filtersFirstCharacters &&
+        (length == 0 || !firstCharacters.test((unsigned char)input[0])))
+        return false;
+
+    for (auto &factor : factors) {
+        if (find(input, length, factor) == length)
+            return false;
+    }
+    return true;
+}
+
+} // namespace Cicero
@@ -0,0 +1,364 @@
+#include "ProgramAnalysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace Cicero {
+
+ProgramAnalysis::ProgramAnalysis(const Instruction *program)
+    : program(program) {
+    findLoop();
+    buildGraph();
+    computeDominators();
+    findFactors();
+    findFirstCharacters();
+}
+
+// Explores the PCs reachable from PC 0, numbering them in reverse postorder.
+void ProgramAnalysis::buildGraph() {
+    successors.assign(ACCEPT_NODE + 1, {});
+    predecessors.assign(ACCEPT_NODE + 1, {});
+    order.clear();
+
+    std::vector<bool> visited(ACCEPT_NODE + 1, false);
+    // Nodes with the index of the next successor to visit.
+    std::vector<std::pair<unsigned short, size_t>> stack;
+    std::vector<unsigned short> postorder;
+
+    auto edge = [&](unsigned short from, unsigned int to) {
+        if (to < INSTR_MEM_SIZE || to == ACCEPT_NODE) {
+            successors[from].push_back(to);
+            predecessors[to].push_back(from);
+        }
+    };
+
+    visited[0] = true;
+    stack.emplace_back(0, 0);
+    while (!stack.empty()) {
+        unsigned short node = stack.back().first;
+
+        if (stack.back().second == 0 && node != ACCEPT_NODE) {
+            const Instruction &instr = program[node];
+            switch (instr.getType()) {
+            case ACCEPT:
+            case ACCEPT_PARTIAL:
+                edge(node, ACCEPT_NODE);
+                break;
+            case SPLIT:
+                edge(node, node + 1);
+                edge(node, instr.getData());
+                break;
+            case JMP:
+                edge(node, instr.getData());
+                break;
+            case MATCH_ANY:
+                if (node != loop)
+                    edge(node, node + 1);
+                break;
+            case MATCH:
+            case NOT_MATCH:
+                edge(node, node + 1);
+                break;
+            default: // END_WITHOUT_ACCEPTING
+                break;
+            }
+        }
+
+        if (stack.back().second < successors[node].size()) {
+            unsigned short next = successors[node][stack.back().second++];
+            if (!visited[next]) {
+                visited[next] = true;
+                stack.emplace_back(next, 0);
+            }
+        } else {
+            postorder.push_back(node);
+            stack.pop_back();
+        }
+    }
+
+    order.assign(postorder.rbegin(), postorder.rend());
+
+    // Only the predecessors that are themselves reachable were added, since
+    // edges are added when their source is explored.
+    live.assign(ACCEPT_NODE + 1, false);
+    if (visited[ACCEPT_NODE]) {
+        std::vector<unsigned short> pending(1, ACCEPT_NODE);
+        live[ACCEPT_NODE] = true;
+        while (!pending.empty()) {
+            unsigned short node = pending.back();
+            pending.pop_back();
+            for (unsigned short previous : predecessors[node]) {
+                if (!live[previous]) {
+                    live[previous] = true;
+                    pending.push_back(previous);
+                }
+            }
+        }
+    }
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm, over the reverse
+// postorder.
+void ProgramAnalysis::computeDominators() {
+    std::vector<unsigned short> rank(ACCEPT_NODE + 1, NO_PC);
+    for (size_t i = 0; i < order.size(); i++) {
+        rank[order[i]] = i;
+    }
+
+    idoms.assign(ACCEPT_NODE + 1, NO_PC);
+    idoms[0] = 0;
+
+    auto intersect = [&](unsigned short a, unsigned short b) {
+        while (a != b) {
+            while (rank[a] > rank[b])
+                a = idoms[a];
+            while (rank[b] > rank[a])
+                b = idoms[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); i++) {
+            unsigned short node = order[i];
+            unsigned short idom = NO_PC;
+            for (unsigned short previous : predecessors[node]) {
+                if (idoms[previous] == NO_PC)
+                    continue;
+                idom = idom == NO_PC ? previous : intersect(previous, idom);
+            }
+            if (idoms[node] != idom) {
+                idoms[node] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    requiredPCs.clear();
+    if (canAccept()) {
+        for (unsigned short node = idoms[ACCEPT_NODE]; node != 0;
+             node = idoms[node]) {
+            requiredPCs.push_back(node);
+        }
+        requiredPCs.push_back(0);
+        std::reverse(requiredPCs.begin(), requiredPCs.end());
+    }
+    idoms[0] = NO_PC;
+}
+
+// As in PatternSet: a MATCH_ANY reached from PC 0 through SPLIT and JMP
+// only, and followed by a jump back to PC 0.
+void ProgramAnalysis::findLoop() {
+    loop = NO_PC;
+
+    std::vector<bool> visited(INSTR_MEM_SIZE, false);
+    std::vector<unsigned short> pending(1, 0);
+    while (!pending.empty()) {
+        unsigned short PC = pending.back();
+        pending.pop_back();
+        if (PC >= INSTR_MEM_SIZE || visited[PC])
+            continue;
+        visited[PC] = true;
+
+        const Instruction &instr = program[PC];
+        switch (instr.getType()) {
+        case SPLIT:
+            pending.push_back(instr.getData());
+            pending.push_back(PC + 1);
+            break;
+        case JMP:
+            pending.push_back(instr.getData());
+            break;
+        case MATCH_ANY:
+            if (PC + 1 < INSTR_MEM_SIZE && program[PC + 1].getType() == JMP &&
+                program[PC + 1].getData() == 0) {
+                loop = PC;
+                return;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// What the threads going from one required PC to the next consume, if they
+// all consume the same number of characters, zero or one: false otherwise,
+// and if a thread can loop or accept on the way.
+bool ProgramAnalysis::consumeBetween(unsigned short from, unsigned short to,
+                                     CharacterClass &consumed,
+                                     bool &consumes) const {
+    // Numbers of characters consumed from each node on to `to`, as a set:
+    // bit 0 for none, bit 1 for one, bit 2 for more.
+    const unsigned char NONE = 1, ONE = 2, MORE = 4, VISITING = 8;
+    std::vector<unsigned char> counts(ACCEPT_NODE + 1, 0);
+    bool valid = true;
+    consumed.reset();
+
+    auto visit = [&](auto &self, unsigned short node) -> unsigned char {
+        if (node == to)
+            return NONE;
+        if (counts[node] == VISITING || node == ACCEPT_NODE) {
+            valid = false;
+            return 0;
+        }
+        if (counts[node] != 0)
+            return counts[node];
+        counts[node] = VISITING;
+
+        const Instruction &instr = program[node];
+        bool consuming =
+            instr.getType() == MATCH || instr.getType() == MATCH_ANY;
+        unsigned char count = 0;
+        for (unsigned short next : successors[node]) {
+            if (live[next])
+                count |= self(self, next);
+        }
+        if (consuming) {
+            count = (count & NONE ? ONE : 0) |
+                    (count & (ONE | MORE) ? MORE : 0);
+            if (instr.getType() == MATCH)
+                consumed.set((unsigned char)instr.getData());
+            else
+                consumed.set();
+        }
+        counts[node] = count;
+        return count;
+    };
+
+    unsigned char count = visit(visit, from);
+    consumes = count == ONE;
+    return valid && (count == NONE || count == ONE);
+}
+
+// Joins the classes consumed between consecutive required PCs into
+// factors, starting a new one wherever the threads do not consume a single
+// character.
+void ProgramAnalysis::findFactors() {
+    factors.clear();
+    if (!canAccept())
+        return;
+
+    std::vector<unsigned short> nodes = requiredPCs;
+    nodes.push_back(ACCEPT_NODE);
+
+    Factor factor;
+    auto close = [&]() {
+        // Classes matching anything only say the input is long enough.
+        while (!factor.empty() && factor.back().all())
+            factor.pop_back();
+        size_t leading = 0;
+        while (leading < factor.size() && factor[leading].all())
+            leading++;
+        factor.erase(factor.begin(), factor.begin() + leading);
+
+        if (!factor.empty() &&
+            std::find(factors.begin(), factors.end(), factor) == factors.end())
+            factors.push_back(factor);
+        factor.clear();
+    };
+
+    for (size_t i = 0; i + 1 < nodes.size(); i++) {
+        CharacterClass consumed;
+        bool consumes;
+        if (!consumeBetween(nodes[i], nodes[i + 1], consumed, consumes))
+            close();
+        else if (consumes)
+            factor.push_back(consumed);
+    }
+    close();
+
+    // Bits of information the classes of a factor carry, the more the more
+    // selective it is.
+    auto selectivity = [](const Factor &factor) {
+        double bits = 0;
+        for (auto &characters : factor) {
+            bits += std::log2(256.0 / characters.count());
+        }
+        return bits;
+    };
+    std::stable_sort(factors.begin(), factors.end(),
+                     [&](const Factor &a, const Factor &b) {
+                         return selectivity(a) > selectivity(b);
+                     });
+}
+
+// Follows SPLIT, JMP and NOT_MATCH from PC 0, collecting what the live
+// MATCH reached consume. The loop is not live, it only leads back to PC 0.
+void ProgramAnalysis::findFirstCharacters() {
+    firstCharacters.reset();
+    if (!canAccept())
+        return;
+
+    std::vector<bool> visited(INSTR_MEM_SIZE, false);
+    std::vector<unsigned short> pending(1, 0);
+    while (!pending.empty()) {
+        unsigned short PC = pending.back();
+        pending.pop_back();
+        if (visited[PC] || !live[PC])
+            continue;
+        visited[PC] = true;
+
+        const Instruction &instr = program[PC];
+        switch (instr.getType()) {
+        case SPLIT:
+        case JMP:
+        case NOT_MATCH:
+            pending.insert(pending.end(), successors[PC].begin(),
+                           successors[PC].end());
+            break;
+        case MATCH:
+            firstCharacters.set((unsigned char)instr.getData());
+            break;
+        default: // MATCH_ANY, ACCEPT and ACCEPT_PARTIAL, since it is live.
+            firstCharacters.set();
+            break;
+        }
+    }
+}
+
+bool ProgramAnalysis::isReachable(unsigned short node) const {
+    return node == 0 || idoms[node] != NO_PC;
+}
+
+const std::vector<unsigned short> &
+ProgramAnalysis::getSuccessors(unsigned short node) const {
+    return successors[node];
+}
+
+unsigned short
+ProgramAnalysis::getImmediateDominator(unsigned short node) const {
+    return idoms[node];
+}
+
+bool ProgramAnalysis::dominates(unsigned short dominator,
+                                unsigned short node) const {
+    if (!isReachable(node))
+        return false;
+    for (; node != NO_PC; node = idoms[node]) {
+        if (node == dominator)
+            return true;
+    }
+    return false;
+}
+
+bool ProgramAnalysis::canAccept() const { return live[0]; }
+
+const std::vector<unsigned short> &ProgramAnalysis::getRequiredPCs() const {
+    return requiredPCs;
+}
+
+unsigned short ProgramAnalysis::getLoop() const { return loop; }
+
+const std::vector<Factor> &ProgramAnalysis::getRequiredFactors() const {
+    return factors;
+}
+
+const CharacterClass &ProgramAnalysis::getFirstCharacters() const {
+    return firstCharacters;
+}
+
+} // namespace Cicero
@@ -0,0 +1,225 @@
+#include "ProgramBundle.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace Cicero {
+
+// Programs are used straight from the mapping.
+static_assert(sizeof(Instruction) == sizeof(uint16_t) &&
+                  std::is_standard_layout<Instruction>::value,
+              "Instruction must have the layout of an instruction word");
+
+// Bundles opened so far by the process, see getId.
+static std::atomic<uint64_t> openings(0);
+
+ProgramBundle::ProgramBundle() {
+    mapping = nullptr;
+    mappingSize = 0;
+    index = nullptr;
+    instructions = nullptr;
+    programCount = 0;
+    id = 0;
+}
+
+ProgramBundle::~ProgramBundle() { close(); }
+
+// Every PC reachable from a well-formed program must stay inside it, since
+// the engines read the program in place.
+bool ProgramBundle::isValidProgram(const Instruction *program, size_t length) {
+    if (length == 0 || length > INSTR_MEM_SIZE)
+        return false;
+
+    for (size_t PC = 0; PC < length; PC++) {
+        switch (program[PC].getType()) {
+        case SPLIT:
+            if (PC + 1 == length || program[PC].getData() >= length)
+                return false;
+            break;
+        case JMP:
+            if (program[PC].getData() >= length)
+                return false;
+            break;
+        case MATCH:
+        case MATCH_ANY:
+        case NOT_MATCH:
+            if (PC + 1 == length)
+                return false;
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+bool ProgramBundle::isBundle(const char *filename) {
+    char magic[4];
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+        return false;
+    bool bundle = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "CICB", 4) == 0;
+    fclose(fp);
+    return bundle;
+}
+
+bool ProgramBundle::open(const char *filename) {
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "[X] Could not open program bundle %s for reading.\n",
+                filename);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 0 ||
+        size_t(info.st_size) < sizeof(Header)) {
+        fprintf(stderr, "[X] Program bundle %s is truncated.\n", filename);
+        ::close(fd);
+        return false;
+    }
+
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        fprintf(stderr, "[X] Could not map program bundle %s.\n", filename);
+        return false;
+    }
+    mapping = static_cast<const unsigned char *>(mapped);
+    mappingSize = info.st_size;
+
+    const Header *header = reinterpret_cast<const Header *>(mapping);
+    size_t dataStart = sizeof(Header) + header->programCount * sizeof(Entry);
+
+    if (memcmp(header->magic, "CICB", 4) != 0 ||
+        header->version != VERSION || header->byteOrder != BYTE_ORDER_MARK ||
+        dataStart > mappingSize) {
+        fprintf(stderr,
+                "[X] %s is not a program bundle of version %u for this "
+                "host.\n",
+                filename, VERSION);
+        close();
+        return false;
+    }
+
+    programCount = header->programCount;
+    index = reinterpret_cast<const Entry *>(mapping + sizeof(Header));
+    instructions = reinterpret_cast<const Instruction *>(mapping + dataStart);
+    size_t instructionCount = (mappingSize - dataStart) / sizeof(Instruction);
+
+    for (size_t i = 0; i < programCount; i++) {
+        if (size_t(index[i].offset) + index[i].length > instructionCount ||
+            !isValidProgram(instructions + index[i].offset,
+                            index[i].length)) {
+            fprintf(stderr,
+                    "[X] Program %zu of bundle %s is malformed or reaches "
+                    "outside of itself.\n",
+                    i, filename);
+            close();
+            return false;
+        }
+    }
+
+    id = ++openings;
+    return true;
+}
+
+void ProgramBundle::close() {
+    if (mapping != nullptr)
+        munmap(const_cast<unsigned char *>(mapping), mappingSize);
+
+    mapping = nullptr;
+    mappingSize = 0;
+    index = nullptr;
+    instructions = nullptr;
+    programCount = 0;
+    id = 0;
+}
+
+bool ProgramBundle::isOpen() const { return mapping != nullptr; }
+
+uint64_t ProgramBundle::getId() const { return id; }
+
+size_t ProgramBundle::getProgramCount() const { return programCount; }
+
+const Instruction *ProgramBundle::getProgram(size_t program) const {
+    return instructions + index[program].offset;
+}
+
+size_t ProgramBundle::getProgramLength(size_t program) const {
+    return index[program].length;
+}
+
+bool ProgramBundle::write(
+    const char *filename,
+    const std::vector<std::vector<Instruction>> &programs) {
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (!isValidProgram(programs[i].data(), programs[i].size())) {
+            fprintf(stderr,
+                    "[X] Program %zu is malformed or reaches outside of "
+                    "itself, not writing bundle %s.\n",
+                    i, filename);
+            return false;
+        }
+    }
+
+    // Written next to it and renamed over it, so that a bundle being read
+    // (or mapped) is never seen half written. mkstemp gives each writer a
+    // file of its own, created for its owner only; bundles are readable by
+    // all.
+    std::string temporary = std::string(filename) + ".XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    FILE *fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (fp == NULL) {
+        fprintf(stderr, "[X] Could not open program bundle %s for writing.\n",
+                temporary.c_str());
+        if (fd >= 0) {
+            ::close(fd);
+            unlink(temporary.c_str());
+        }
+        return false;
+    }
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+    Header header;
+    memcpy(header.magic, "CICB", 4);
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.programCount = programs.size();
+
+    std::vector<Entry> entries;
+    uint32_t offset = 0;
+    for (auto &program : programs) {
+        entries.push_back({offset, uint32_t(program.size())});
+        offset += program.size();
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                   fwrite(entries.data(), sizeof(Entry), entries.size(), fp) ==
+                       entries.size();
+    for (size_t i = 0; i < programs.size() && written; i++) {
+        written = fwrite(programs[i].data(), sizeof(Instruction),
+                         programs[i].size(), fp) == programs[i].size();
+    }
+
+    if (fclose(fp) != 0 || !written ||
+        rename(temporary.c_str(), filename) != 0) {
+        fprintf(stderr, "[X] Could not write program bundle %s.\n", filename);
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace Cicero
@@ -0,0 +1,210 @@
+#include "ProgramOptimizer.h"
+
+#include <vector>
+
+namespace Cicero {
+
+namespace {
+
+bool isTerminal(unsigned short type) {
+    return type == ACCEPT || type == ACCEPT_PARTIAL ||
+           type == END_WITHOUT_ACCEPTING;
+}
+
+bool fallsThrough(unsigned short type) {
+    return type == SPLIT || type == MATCH || type == MATCH_ANY ||
+           type == NOT_MATCH;
+}
+
+bool isJump(unsigned short type) { return type == JMP || type == SPLIT; }
+
+// A JMP or SPLIT whose every way leads to the next PC.
+bool isNop(const Instruction &instr, unsigned short PC) {
+    return isJump(instr.getType()) && instr.getData() == PC + 1;
+}
+
+Instruction makeInstruction(unsigned short type, unsigned short data) {
+    return Instruction(type << (BITS_INSTR - BITS_INSTR_TYPE) | data);
+}
+
+} // namespace
+
+// Stops at PC 0, where passing restarts the match, and after as many hops as
+// there are PCs, on a JMP cycle.
+unsigned short ProgramOptimizer::resolve(const Instruction *program,
+                                         unsigned short PC) {
+    for (int hops = 0; hops < INSTR_MEM_SIZE; hops++) {
+        if (PC == 0 || PC >= INSTR_MEM_SIZE)
+            break;
+        const Instruction &instr = program[PC];
+        if (instr.getType() == JMP)
+            PC = instr.getData();
+        else if (isNop(instr, PC))
+            PC++;
+        else
+            break;
+    }
+    return PC;
+}
+
+std::vector<bool> ProgramOptimizer::findReachable(const Instruction *program) {
+    std::vector<bool> reachable(INSTR_MEM_SIZE, false);
+    std::vector<unsigned short> pending(1, 0);
+    while (!pending.empty()) {
+        unsigned short PC = pending.back();
+        pending.pop_back();
+        if (PC >= INSTR_MEM_SIZE || reachable[PC])
+            continue;
+        reachable[PC] = true;
+
+        const Instruction &instr = program[PC];
+        if (isJump(instr.getType()))
+            pending.push_back(instr.getData());
+        if (fallsThrough(instr.getType()))
+            pending.push_back(PC + 1);
+    }
+    return reachable;
+}
+
+uint64_t ProgramOptimizer::hashReachable(const Instruction *program,
+                                         const std::vector<bool> &reachable,
+                                         uint64_t seed) {
+    uint64_t hash = 14695981039346656037ull ^ seed;
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (!reachable[PC])
+            continue;
+        unsigned short instr =
+            program[PC].getType() << (BITS_INSTR - BITS_INSTR_TYPE) |
+            program[PC].getData();
+        for (unsigned short word : {(unsigned short)PC, instr}) {
+            for (int byte = 0; byte < 2; byte++) {
+                hash ^= (word >> (8 * byte)) & 0xff;
+                hash *= 1099511628211ull;
+            }
+        }
+    }
+    return hash;
+}
+
+ProgramOptimizer::ProgramOptimizer(const Instruction *program,
+                                   size_t length) {
+    stats.originalLength = length;
+
+    // Only the reachable instructions are read, as a program of a bundle
+    // ends where they do.
+    std::vector<bool> reachable = findReachable(program);
+    std::vector<Instruction> rewritten(INSTR_MEM_SIZE);
+    for (unsigned short PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (reachable[PC])
+            rewritten[PC] = program[PC];
+    }
+
+    // Jump threading and folding, each instruction rewritten from the
+    // original program.
+    for (unsigned short PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        const Instruction &instr = program[PC];
+        if (!reachable[PC] || !isJump(instr.getType()))
+            continue;
+
+        unsigned short target = resolve(program, instr.getData());
+        if (instr.getType() == SPLIT && target == resolve(program, PC + 1)) {
+            rewritten[PC] = makeInstruction(JMP, target);
+            stats.foldedSplits++;
+        } else if (target != instr.getData()) {
+            rewritten[PC] = makeInstruction(instr.getType(), target);
+            stats.threadedJumps++;
+        }
+    }
+
+    // A terminal instruction only reached through a JMP takes its place.
+    // One reached in other ways too is left alone: threads from different
+    // starts meeting on it keep a single match span, which copies would not.
+    reachable = findReachable(rewritten.data());
+    std::vector<int> predecessors(INSTR_MEM_SIZE, 0);
+    for (unsigned short PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        const Instruction &instr = rewritten[PC];
+        if (!reachable[PC])
+            continue;
+        if (isJump(instr.getType()) && instr.getData() < INSTR_MEM_SIZE)
+            predecessors[instr.getData()]++;
+        if (fallsThrough(instr.getType()) && PC + 1 < INSTR_MEM_SIZE)
+            predecessors[PC + 1]++;
+    }
+    for (unsigned short PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        const Instruction &instr = rewritten[PC];
+        unsigned short target = instr.getData();
+        if (reachable[PC] && instr.getType() == JMP && target != 0 &&
+            target < INSTR_MEM_SIZE && predecessors[target] == 1 &&
+            isTerminal(rewritten[target].getType())) {
+            rewritten[PC] = rewritten[target];
+            stats.inlinedTerminals++;
+        }
+    }
+
+    // Dead code. Past a last instruction leading out of the program memory,
+    // threads are dropped; moved up, it would lead into other code instead.
+    reachable = findReachable(rewritten.data());
+    const Instruction &last = rewritten[INSTR_MEM_SIZE - 1];
+    bool compact = !reachable[INSTR_MEM_SIZE - 1] ||
+                   !fallsThrough(last.getType());
+
+    std::vector<bool> kept(INSTR_MEM_SIZE, true);
+    for (unsigned short PC = 0; compact && PC < INSTR_MEM_SIZE; PC++) {
+        if (!reachable[PC]) {
+            kept[PC] = false;
+            if (PC < length)
+                stats.removedUnreachable++;
+        } else if (PC != 0 && isNop(rewritten[PC], PC)) {
+            kept[PC] = false;
+            stats.removedNops++;
+        }
+    }
+
+    // A dropped instruction is renumbered as the next one kept, which is
+    // where a NOP leads.
+    std::vector<unsigned short> newPCs(INSTR_MEM_SIZE + 1);
+    unsigned short count = 0;
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (kept[PC])
+            newPCs[PC] = count++;
+    }
+    newPCs[INSTR_MEM_SIZE] = count;
+    for (int PC = INSTR_MEM_SIZE - 1; PC >= 0; PC--) {
+        if (!kept[PC])
+            newPCs[PC] = newPCs[PC + 1];
+    }
+
+    std::vector<bool> isTarget(INSTR_MEM_SIZE, false);
+    for (int PC = 0; PC < INSTR_MEM_SIZE; PC++) {
+        if (!kept[PC])
+            continue;
+        Instruction instr = rewritten[PC];
+        if (isJump(instr.getType()) && instr.getData() < INSTR_MEM_SIZE) {
+            instr = makeInstruction(instr.getType(),
+                                    newPCs[instr.getData()]);
+            isTarget[instr.getData()] = true;
+        }
+        optimized.push_back(instr);
+    }
+    stats.optimizedLength = optimized.size();
+
+    for (size_t PC = 0; PC < optimized.size(); PC++) {
+        if (optimized[PC].getType() != MATCH)
+            continue;
+        size_t runEnd = PC + 1;
+        while (runEnd < optimized.size() &&
+               optimized[runEnd].getType() == MATCH && !isTarget[runEnd])
+            runEnd++;
+        if (runEnd - PC > 1)
+            stats.literalRuns.emplace_back(PC, runEnd - PC);
+        PC = runEnd - 1;
+    }
+}
+
+const std::vector<Instruction> &ProgramOptimizer::getProgram() const {
+    return optimized;
+}
+
+const OptimizerStats &ProgramOptimizer::getStats() const { return stats; }
+
+} // namespace Cicero
@@ -0,0 +1,121 @@
+#include "ThreadPool.h"
+
+#include <thread>
+
+namespace Cicero {
+
+ThreadPool::ThreadPool(unsigned workers) {
+    if (workers == 0)
+        workers = std::thread::hardware_concurrency();
+    if (workers == 0)
+        workers = 1;
+
+    workerCount = workers;
+    for (unsigned i = 0; i < workerCount; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned i = 1; i < workerCount; i++) {
+        threads.emplace_back([this, i]() { loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+// Waits for each run, works on it, and reports when done.
+void ThreadPool::loop(unsigned worker) {
+    uint64_t seen = 0;
+    while (true) {
+        const std::function<void(unsigned, size_t)> *job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&]() { return stopping || round != seen; });
+            if (stopping)
+                return;
+            seen = round;
+            job = body;
+        }
+
+        work(worker, *job);
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+unsigned ThreadPool::getWorkerCount() const { return workerCount; }
+
+bool ThreadPool::popOwn(unsigned worker, size_t &task) {
+    WorkQueue &queue = *queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+
+    if (queue.tasks.empty())
+        return false;
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned thief, size_t &task) {
+    for (unsigned i = 1; i < workerCount; i++) {
+        WorkQueue &victim = *queues[(thief + i) % workerCount];
+        std::lock_guard<std::mutex> guard(victim.lock);
+
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(unsigned worker,
+                      const std::function<void(unsigned, size_t)> &body) {
+    size_t task;
+
+    // Tasks are never added while running, so once every queue is found
+    // empty there is nothing left to do.
+    while (popOwn(worker, task) || steal(worker, task)) {
+        body(worker, task);
+    }
+}
+
+void ThreadPool::run(size_t taskCount,
+                     const std::function<void(unsigned, size_t)> &body) {
+    for (unsigned i = 0; i < workerCount; i++) {
+        size_t first = taskCount * i / workerCount;
+        size_t last = taskCount * (i + 1) / workerCount;
+
+        std::lock_guard<std::mutex> guard(queues[i]->lock);
+        for (size_t task = first; task < last; task++) {
+            queues[i]->tasks.push_back(task);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        this->body = &body;
+        busy = threads.size();
+        round++;
+    }
+    wake.notify_all();
+
+    // The calling thread acts as worker 0.
+    work(0, body);
+
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this]() { return busy == 0; });
+    this->body = nullptr;
+}
+
+} // namespace Cicero
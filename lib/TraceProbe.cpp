@@ -0,0 +1,79 @@
+#include "TraceProbe.h"
+
+namespace Cicero {
+
+static const char *typeNames[8] = {
+    "ACCEPT",    "SPLIT",          "MATCH",    "JMP", "END_WITHOUT_ACCEPTING",
+    "MATCH_ANY", "ACCEPT_PARTIAL", "NOT_MATCH"};
+
+void TraceProbe::setOutput(FILE *file) { output = file; }
+
+void TraceProbe::begin(const char *event) {
+    fprintf(output, "{\"cycle\":%d,\"event\":\"%s\"", clockCycle, event);
+}
+
+void TraceProbe::onStart(int windowSize) {
+    clockCycle = 0;
+    begin("start");
+    fprintf(output, ",\"window_size\":%d}\n", windowSize);
+}
+
+void TraceProbe::onCycle(int cycle, size_t windowIndex) {
+    clockCycle = cycle;
+    begin("cycle");
+    fprintf(output, ",\"window\":%zu}\n", windowIndex);
+}
+
+void TraceProbe::onStall(int stage) {
+    begin("stall");
+    fprintf(output, ",\"stage\":%d}\n", stage);
+}
+
+void TraceProbe::onFetch(CoreOUT thread, const Instruction &instruction) {
+    begin("fetch");
+    fprintf(output, ",\"pc\":%d,\"cc_id\":%d,\"type\":\"%s\",\"data\":%d}\n",
+            thread.getPC(), thread.getCC_ID(),
+            typeNames[instruction.getType()], instruction.getData());
+}
+
+void TraceProbe::onExecute(CoreOUT thread, const Instruction &instruction,
+                           char currentChar) {
+    begin("execute");
+    fprintf(output,
+            ",\"pc\":%d,\"cc_id\":%d,\"type\":\"%s\",\"data\":%d,"
+            "\"char\":%d}\n",
+            thread.getPC(), thread.getCC_ID(),
+            typeNames[instruction.getType()], instruction.getData(),
+            (unsigned char)currentChar);
+}
+
+void TraceProbe::onDrop(CoreOUT thread) {
+    begin("drop");
+    fprintf(output, ",\"pc\":%d,\"cc_id\":%d}\n", thread.getPC(),
+            thread.getCC_ID());
+}
+
+void TraceProbe::onPush(const Buffers & /*buffers*/, CoreOUT thread,
+                        int stage) {
+    begin("push");
+    fprintf(output, ",\"stage\":%d,\"pc\":%d,\"cc_id\":%d}\n", stage,
+            thread.getPC(), thread.getCC_ID());
+}
+
+void TraceProbe::onAccept(const MatchSpan &span) {
+    begin("accept");
+    fprintf(output, ",\"start\":%zu,\"end\":%zu}\n", span.start, span.end);
+}
+
+void TraceProbe::onSlide(unsigned short distance, size_t windowIndex) {
+    begin("slide");
+    fprintf(output, ",\"distance\":%d,\"window\":%zu}\n", distance,
+            windowIndex);
+}
+
+void TraceProbe::onFinish(bool accepted) {
+    begin("finish");
+    fprintf(output, ",\"accepted\":%s}\n", accepted ? "true" : "false");
+}
+
+} // namespace Cicero
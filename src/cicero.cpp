@@ -1,24 +1,313 @@
 #include "CiceroMulti.h"
+#include "ProgramBundle.h"
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Matches every input of a file against every program given, on all the
+// cores, and prints the verdicts to stdout:
+//
+//   csv   regex,input,True|False rows, as in test/protomata_results.csv
+//   json  an array of {"regex", "input", "match"} objects, with the "name"
+//         of the input for FASTA records
+//
+// Programs are numbered in the order given, those of a bundle in the order
+// they were packed. The inputs are read one per line or, when the file
+// starts with '>', as FASTA records; they are read and matched a chunk at a
+// time, with the same threads, programs and DFA states for every chunk, and
+// the verdicts of each chunk are printed as soon as it is matched, program
+// after program, so that nothing is kept from one chunk to the next. A
+// throughput summary is printed to stderr at the end.
+
+namespace {
+
+const size_t DEFAULT_CHUNK_SIZE = 4096;
+// The engines take the window plus one as an unsigned short.
+const unsigned long MAX_WINDOW = 65534;
+// Far more than the hardware threads of any machine it runs on.
+const unsigned long MAX_THREADS = 1024;
+
+const char *const USAGE =
+    "Usage: %s [--input <file>] [--json] [--matches-only]\n"
+    "       [--mode cycle|pike|dfa|bit|lockstep|jit] [--window <W>]\n"
+    "       [--threads <N>] [--chunk <N>] [--no-prefilter]\n"
+    "       <program or bundle>...\n"
+    "\n"
+    "Reads the inputs from stdin when no file (or -) is given, and matches\n"
+    "them --chunk at a time (4096 by default). The default mode is dfa,\n"
+    "and the default thread count (0) one per hardware thread.\n";
+
+struct Options {
+    std::string inputPath = "-";
+    bool json = false;
+    bool matchesOnly = false;
+    Cicero::ExecutionMode mode = Cicero::LAZY_DFA;
+    unsigned short window = 1;
+    unsigned threads = 0;
+    size_t chunkSize = DEFAULT_CHUNK_SIZE;
+    bool prefilter = true;
+    std::vector<std::string> programPaths;
+};
+
+bool parseMode(const std::string &name, Cicero::ExecutionMode &mode) {
+    if (name == "cycle")
+        mode = Cicero::CYCLE_ACCURATE;
+    else if (name == "pike")
+        mode = Cicero::PIKE_VM;
+    else if (name == "dfa")
+        mode = Cicero::LAZY_DFA;
+    else if (name == "bit")
+        mode = Cicero::BIT_PARALLEL;
+    else if (name == "lockstep")
+        mode = Cicero::LOCKSTEP;
+    else if (name == "jit")
+        mode = Cicero::JIT;
+    else
+        return false;
+    return true;
+}
+
+// A decimal number from min to max, and nothing else: strtoul alone takes
+// leading blanks and a sign, and wraps negative numbers around.
+bool parseNumber(const char *option, const char *text, unsigned long min,
+                 unsigned long max, unsigned long &value) {
+    char *end;
+    errno = 0;
+    if (isdigit((unsigned char)text[0])) {
+        value = strtoul(text, &end, 10);
+        if (errno == 0 && *end == '\0' && value >= min && value <= max)
+            return true;
+    }
+    fprintf(stderr, "[X] %s takes a number from %lu to %lu, not %s.\n",
+            option, min, max, text);
+    return false;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--json") {
+            options.json = true;
+        } else if (option == "--matches-only") {
+            options.matchesOnly = true;
+        } else if (option == "--no-prefilter") {
+            options.prefilter = false;
+        } else if (option == "--input" && hasValue) {
+            options.inputPath = argv[++i];
+        } else if (option == "--mode" && hasValue) {
+            if (!parseMode(argv[++i], options.mode)) {
+                fprintf(stderr, "[X] Unknown execution mode %s.\n", argv[i]);
+                return false;
+            }
+        } else if (option == "--window" && hasValue) {
+            unsigned long window;
+            if (!parseNumber("--window", argv[++i], 1, MAX_WINDOW, window))
+                return false;
+            options.window = window;
+        } else if (option == "--threads" && hasValue) {
+            unsigned long threads;
+            if (!parseNumber("--threads", argv[++i], 0, MAX_THREADS,
+                             threads))
+                return false;
+            options.threads = threads;
+        } else if (option == "--chunk" && hasValue) {
+            unsigned long chunkSize;
+            if (!parseNumber("--chunk", argv[++i], 1, SIZE_MAX, chunkSize))
+                return false;
+            options.chunkSize = chunkSize;
+        } else if (option.size() > 1 && option[0] == '-') {
+            return false;
+        } else {
+            options.programPaths.push_back(option);
+        }
+    }
+    return !options.programPaths.empty();
+}
+
+// Reads inputs one per line, or FASTA records whose sequence may span many
+// lines, whichever the input starts with.
+class InputReader {
+  private:
+    std::istream &stream;
+    std::string line;
+    bool fasta;
+    bool pending; // line holds the header of the next FASTA record
+
+  public:
+    InputReader(std::istream &stream) : stream(stream), pending(false) {
+        fasta = stream.peek() == '>';
+    }
+
+    bool isFasta() const { return fasta; }
+
+    // The name is the first word of the FASTA header, empty for lines.
+    bool next(std::string &input, std::string &name) {
+        input.clear();
+        name.clear();
+
+        if (!fasta) {
+            if (!std::getline(stream, input))
+                return false;
+            if (!input.empty() && input.back() == '\r')
+                input.pop_back();
+            return true;
+        }
+
+        if (!pending && !std::getline(stream, line))
+            return false;
+        name = line.substr(1, line.find_first_of(" \t\r") - 1);
+        pending = false;
+        while (std::getline(stream, line)) {
+            if (!line.empty() && line[0] == '>') {
+                pending = true;
+                break;
+            }
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            input += line;
+        }
+        return true;
+    }
+};
+
+void printJsonString(const std::string &text) {
+    putchar('"');
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
 
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <path/to/program>", argv[0]);
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, USAGE, argv[0]);
         return -1;
     }
 
-    auto CICERO = Cicero::CiceroMulti(1, true);
-    CICERO.setProgram(argv[1]);
+    // Program files are loaded into memory once; bundles stay mapped.
+    std::vector<std::vector<Cicero::Instruction>> files;
+    std::vector<std::unique_ptr<Cicero::ProgramBundle>> bundles;
+    std::vector<const Cicero::Instruction *> programs;
+    for (auto &path : options.programPaths) {
+        if (Cicero::ProgramBundle::isBundle(path.c_str())) {
+            bundles.push_back(std::make_unique<Cicero::ProgramBundle>());
+            if (!bundles.back()->open(path.c_str()))
+                return -1;
+            for (size_t i = 0; i < bundles.back()->getProgramCount(); i++) {
+                programs.push_back(bundles.back()->getProgram(i));
+            }
+        } else {
+            files.emplace_back(Cicero::INSTR_MEM_SIZE);
+            if (!Cicero::CiceroMulti::readProgram(path.c_str(),
+                                                  files.back().data()))
+                return -1;
+            programs.push_back(files.back().data());
+        }
+    }
 
-    bool matchResult = CICERO.match("RKMS");
+    std::ifstream inputFile;
+    if (options.inputPath != "-") {
+        inputFile.open(options.inputPath);
+        if (!inputFile.is_open()) {
+            fprintf(stderr, "[X] Could not open input file %s for reading.\n",
+                    options.inputPath.c_str());
+            return -1;
+        }
+    }
+    InputReader reader(options.inputPath == "-" ? std::cin : inputFile);
 
-    if (matchResult)
-        printf("regex %d 	, input %d (len: %d)	, match True\n", 0, 0,
-               256);
-    else
-        printf("regex %d 	, input %d (len: %d)	, match False\n", 0, 0,
-               256);
+    Cicero::CiceroMulti cicero(options.window, false, options.mode);
+    if (!options.prefilter)
+        cicero.setPrefilter(false);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t inputCount = 0;
+    size_t byteCount = 0;
+    size_t matchCount = 0;
+    // The inputs of the chunk, and the names of the FASTA records.
+    std::vector<std::string> inputs;
+    std::vector<std::string> names;
+    std::string input;
+    std::string name;
+
+    bool firstRow = true;
+    if (options.json)
+        printf("[");
+    bool more = true;
+    while (more) {
+        inputs.clear();
+        names.clear();
+        while (inputs.size() < options.chunkSize &&
+               (more = reader.next(input, name))) {
+            byteCount += input.size();
+            inputs.push_back(input);
+            if (reader.isFasta())
+                names.push_back(name);
+        }
+        if (inputs.empty())
+            break;
+
+        Cicero::BatchResult result =
+            cicero.matchBatch(programs, inputs, options.threads);
+        for (size_t program = 0; program < programs.size(); program++) {
+            for (size_t i = 0; i < inputs.size(); i++) {
+                bool match = result.isMatch(program, i);
+                matchCount += match;
+                if (options.matchesOnly && !match)
+                    continue;
+
+                if (!options.json) {
+                    printf("%zu,%zu,%s\n", program, inputCount + i,
+                           match ? "True" : "False");
+                    continue;
+                }
+                printf("%s\n  {\"regex\": %zu, \"input\": %zu, ",
+                       firstRow ? "" : ",", program, inputCount + i);
+                if (reader.isFasta()) {
+                    printf("\"name\": ");
+                    printJsonString(names[i]);
+                    printf(", ");
+                }
+                printf("\"match\": %s}", match ? "true" : "false");
+                firstRow = false;
+            }
+        }
+        fflush(stdout);
+        inputCount += inputs.size();
+    }
+
+    if (options.json)
+        printf("%s]\n", firstRow ? "" : "\n");
+    fflush(stdout);
 
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    size_t pairs = programs.size() * inputCount;
+    fprintf(stderr,
+            "%zu programs x %zu inputs (%zu bytes): %zu of %zu pairs match, "
+            "in %.3f s: %.0f matches/s, %.2f MB/s of input\n",
+            programs.size(), inputCount, byteCount, matchCount, pairs,
+            seconds, seconds > 0 ? pairs / seconds : 0,
+            seconds > 0 ? byteCount / seconds / 1e6 : 0);
     return 0;
 }
@@ -0,0 +1,43 @@
+#include "CiceroMulti.h"
+#include "ProgramOptimizer.h"
+#include <cstdio>
+
+// Writes the optimized version of a compiled program file, in the same
+// format, and reports what the optimizer did.
+int main(int argc, char **argv) {
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <path/to/program> <path/to/output>\n",
+                argv[0]);
+        return -1;
+    }
+
+    Cicero::Instruction program[Cicero::INSTR_MEM_SIZE];
+    size_t length;
+    if (!Cicero::CiceroMulti::readProgram(argv[1], program, false, &length))
+        return -1;
+
+    Cicero::ProgramOptimizer optimizer(program, length);
+
+    FILE *fp = fopen(argv[2], "w");
+    if (fp == NULL) {
+        fprintf(stderr, "[X] Could not open %s for writing.\n", argv[2]);
+        return -1;
+    }
+    for (auto &instr : optimizer.getProgram()) {
+        fprintf(fp, "0x%04x\n",
+                instr.getType() << (Cicero::BITS_INSTR -
+                                    Cicero::BITS_INSTR_TYPE) |
+                    instr.getData());
+    }
+    fclose(fp);
+
+    const Cicero::OptimizerStats &stats = optimizer.getStats();
+    printf("%zu instructions, %zu after optimization: %zu jumps threaded, "
+           "%zu terminals inlined, %zu splits folded, %zu NOPs and %zu "
+           "unreachable instructions removed, %zu literal runs\n",
+           stats.originalLength, stats.optimizedLength, stats.threadedJumps,
+           stats.inlinedTerminals, stats.foldedSplits, stats.removedNops,
+           stats.removedUnreachable, stats.literalRuns.size());
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include "CiceroMulti.h"
+#include "ProgramBundle.h"
+#include <cstdio>
+#include <vector>
+
+// Packs compiled program files into a bundle, in the order given: the i-th
+// program file becomes program i of the bundle.
+int main(int argc, char **argv) {
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <path/to/bundle> <path/to/program>...\n",
+                argv[0]);
+        return -1;
+    }
+
+    std::vector<std::vector<Cicero::Instruction>> programs;
+    Cicero::Instruction program[Cicero::INSTR_MEM_SIZE];
+
+    for (int i = 2; i < argc; i++) {
+        size_t length;
+        if (!Cicero::CiceroMulti::readProgram(argv[i], program, false,
+                                              &length))
+            return -1;
+        programs.emplace_back(program, program + length);
+    }
+
+    if (!Cicero::ProgramBundle::write(argv[1], programs))
+        return -1;
+
+    printf("Packed %zu programs into %s\n", programs.size(), argv[1]);
+    return 0;
+}
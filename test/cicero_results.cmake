@@ -0,0 +1,48 @@
+# Runs cicero on test/strings.txt against every program of test/programs, in
+# order, a few inputs at a time, and checks its rows against those of
+# test/protomata_results.csv, as sets: cicero prints them a chunk at a time.
+# Both are sorted by program and input, the numbers padded to sort as such.
+# Programs are numbered in the order given, and in the CSV after their file,
+# so the program numbers are then left out of the comparison.
+#
+#   cmake -DCICERO=<cicero> -DTEST_DIR=<test> -P cicero_results.cmake
+
+file(GLOB files RELATIVE ${TEST_DIR}/programs ${TEST_DIR}/programs/*)
+list(LENGTH files count)
+set(programs)
+set(found 0)
+set(number 0)
+while(found LESS count)
+    if(EXISTS ${TEST_DIR}/programs/${number})
+        list(APPEND programs ${TEST_DIR}/programs/${number})
+        math(EXPR found "${found} + 1")
+    endif()
+    math(EXPR number "${number} + 1")
+endwhile()
+
+execute_process(
+        COMMAND ${CICERO} --chunk 7 --threads 2 --input ${TEST_DIR}/strings.txt
+                ${programs}
+        OUTPUT_VARIABLE rows
+        RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cicero failed: ${result}")
+endif()
+file(READ ${TEST_DIR}/protomata_results.csv expected)
+
+set(digits "[0-9][0-9][0-9][0-9][0-9][0-9]")
+foreach(table rows expected)
+    string(STRIP "${${table}}" sorted)
+    string(REGEX REPLACE "(^|\n)([0-9]+),([0-9]+)," "\\1000000\\2,000000\\3,"
+           sorted "${sorted}")
+    string(REGEX REPLACE "(^|\n)0*(${digits}),0*(${digits})," "\\1\\2,\\3,"
+           sorted "${sorted}")
+    string(REPLACE "\n" ";" sorted "${sorted}")
+    list(SORT sorted)
+    string(REPLACE ";" "\n" sorted "${sorted}")
+    string(REGEX REPLACE "(^|\n)[0-9]+," "\\1" ${table} "${sorted}")
+endforeach()
+if(NOT rows STREQUAL expected)
+    message(FATAL_ERROR "cicero disagrees with protomata_results.csv")
+endif()
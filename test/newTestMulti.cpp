@@ -1,14 +1,43 @@
 #include "CiceroMulti.h"
+#include "ClassRewriter.h"
+#include "LazyDFA.h"
+#include "Manager.h"
+#include "PikeVM.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <ios>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 const int PROGRAMS_COUNT = 1308;
 const int INPUT_COUNT = 100;
 
+// Heap allocations made so far by the whole program.
+size_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    if (void *memory = malloc(size > 0 ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+
 struct CorrectResult {
     int regexNumber;
     int inputNumber;
@@ -80,8 +109,248 @@ std::vector<CorrectResult> getCorrectResults() {
     return returnValue;
 }
 
-int main() {
-    auto cicero = Cicero::CiceroMulti(2);
+// test_multi [mode] [variant] [option], where the mode is the execution mode
+// under test, cycle by default:
+//
+//   cycle, pike, dfa, bit, jit
+//   lockstep     matches all the inputs against a program at once
+//
+// the variant how the matches are run:
+//
+//   batch        through matchBatch
+//   bundle       from the programs packed in a bundle
+//   stream       through a stream, in small uneven chunks
+//   scan         reporting every match span, checked against the PikeVM
+//   set          all the programs at once on each input, with a PatternSet
+//   stats        collecting the hardware counters of every match
+//   noalloc      on slices of one buffer, checking that no match allocates
+//   manager <N>  on a Manager of N engines
+//   smallcache   on lazy DFAs whose caches hold one state or only a few,
+//                on the string and on a stream
+//   noprefilter  on every input, without the prefilter of the programs
+//   prefilter    only on the inputs the prefilter lets through, even in the
+//                cycle accurate mode
+//   dedup        on every input, with the buffers dropping duplicate threads
+//   wide         on a cycle accurate engine with a window wider than a
+//                machine word
+//
+// and the option, which may also follow a variant:
+//
+//   optimize     runs the programs as ProgramOptimizer rewrites them
+//   classes      runs them with their character classes rewritten into
+//                MATCH_SET
+//   sample       only runs every 25th program
+//   lowmemory    keeps the programs and DFA states within 1 MiB, so that
+//                they are dropped over and over
+bool parseMode(int argc, char **argv, Cicero::ExecutionMode &mode) {
+    std::string name = argc > 1 ? argv[1] : "cycle";
+
+    if (name == "cycle") {
+        mode = Cicero::CYCLE_ACCURATE;
+    } else if (name == "pike") {
+        mode = Cicero::PIKE_VM;
+    } else if (name == "dfa") {
+        mode = Cicero::LAZY_DFA;
+    } else if (name == "bit") {
+        mode = Cicero::BIT_PARALLEL;
+    } else if (name == "lockstep") {
+        mode = Cicero::LOCKSTEP;
+    } else if (name == "jit") {
+        mode = Cicero::JIT;
+    } else {
+        std::cerr << "Unknown execution mode '" << name << "'.\n";
+        return false;
+    }
+    return true;
+}
+
+// How the matches of the variant are run; the other variants only change
+// the settings.
+enum class Variant {
+    MATCH,
+    BATCH,
+    BUNDLE,
+    STREAM,
+    SCAN,
+    SET,
+    STATS,
+    NOALLOC,
+    MANAGER,
+    SMALL_CACHE,
+};
+
+Variant parseVariant(int argc, char **argv) {
+    static const std::pair<const char *, Variant> variants[] = {
+        {"batch", Variant::BATCH},     {"bundle", Variant::BUNDLE},
+        {"stream", Variant::STREAM},   {"scan", Variant::SCAN},
+        {"set", Variant::SET},         {"stats", Variant::STATS},
+        {"noalloc", Variant::NOALLOC}, {"manager", Variant::MANAGER},
+        {"smallcache", Variant::SMALL_CACHE},
+    };
+    for (auto &variant : variants) {
+        if (argc > 2 && std::string(argv[2]) == variant.first)
+            return variant.second;
+    }
+    return Variant::MATCH;
+}
+
+// Hands out input a few characters at a time, so that matches cross many
+// chunk boundaries and the stream has to grow and compact its buffer.
+Cicero::InputStream::Reader trickle(const std::string &input,
+                                    size_t &position) {
+    position = 0;
+    return [&](char *buffer, size_t capacity) -> size_t {
+        size_t count = std::min({capacity, input.size() - position,
+                                 size_t(7)});
+        memcpy(buffer, input.data() + position, count);
+        position += count;
+        return count;
+    };
+}
+
+bool matchStreamed(Cicero::CiceroMulti &cicero, const std::string &input) {
+    size_t position;
+    return cicero.matchStream(trickle(input, position), 16);
+}
+
+// tiny only holds its start state, so that it finishes every input on the
+// PikeVM; small holds a few states, so that it fills up and flushes its cache
+// along the way. Both must agree on the string and on a stream.
+bool matchSmallCaches(Cicero::LazyDFA &tiny, Cicero::LazyDFA &small,
+                      const std::string &input) {
+    bool result = tiny.match(input);
+    for (Cicero::LazyDFA *dfa : {&tiny, &small}) {
+        size_t position;
+        Cicero::InputStream stream(trickle(input, position), 16);
+        if (dfa->match(input) != result || dfa->match(stream) != result) {
+            std::cerr << "Lazy DFAs with small caches disagree on input "
+                      << input << ".\n";
+            throw -1;
+        }
+    }
+    return result;
+}
+
+// Every span the scan reports, as many times as it does, sorted.
+std::vector<std::pair<size_t, size_t>>
+scanSpans(const std::function<size_t(const Cicero::MatchCallback &)> &scan) {
+    std::vector<std::pair<size_t, size_t>> spans;
+    scan([&](const Cicero::MatchSpan &span) {
+        spans.emplace_back(span.start, span.end);
+    });
+    std::sort(spans.begin(), spans.end());
+    return spans;
+}
+
+// The spans must be those the PikeVM reports on the program, each as many
+// times: this catches wrong starts and ends, and missing or duplicated
+// spans.
+bool matchScanned(Cicero::CiceroMulti &cicero, Cicero::PikeVM &reference,
+                  const std::string &input) {
+    auto spans = scanSpans([&](const Cicero::MatchCallback &onMatch) {
+        return cicero.scan(input, onMatch);
+    });
+    auto expected = scanSpans([&](const Cicero::MatchCallback &onMatch) {
+        return reference.scan(input, onMatch);
+    });
+
+    if (spans != expected) {
+        std::cerr << "Scan of " << input << " reported " << spans.size()
+                  << " spans, the PikeVM " << expected.size() << ":";
+        for (auto &span : spans) {
+            std::cerr << " [" << span.first << ", " << span.second << ")";
+        }
+        std::cerr << " instead of";
+        for (auto &span : expected) {
+            std::cerr << " [" << span.first << ", " << span.second << ")";
+        }
+        std::cerr << ".\n";
+        throw -1;
+    }
+    return !spans.empty();
+}
+
+// input is a slice of the inputs laid end to end, so not followed by '\0'.
+// Once a first match has warmed the engines up, matching it again must not
+// allocate.
+bool matchWithoutAllocating(Cicero::CiceroMulti &cicero,
+                            std::string_view input) {
+    bool result = cicero.match(input);
+
+    size_t before = allocations;
+    if (cicero.match(input) != result || allocations != before) {
+        std::cerr << "Matching input " << input << " allocated "
+                  << allocations - before << " times.\n";
+        throw -1;
+    }
+    return result;
+}
+
+// Every cycle, stage 2 either executes an instruction or stalls, and the
+// match accepts once if it does.
+bool matchWithStats(Cicero::CiceroMulti &cicero, const std::string &input) {
+    Cicero::EngineStats stats;
+    bool result = cicero.match(input, stats);
+
+    uint64_t executed = 0;
+    for (auto count : stats.instructions) {
+        executed += count;
+    }
+    if (executed + stats.stalls[1] != stats.clockCycles ||
+        stats.accepts != result ||
+        stats.slideDistance > input.size() + stats.highWaterMarks.size()) {
+        std::cerr << "Inconsistent stats for input " << input << ".\n";
+        throw -1;
+    }
+    return result;
+}
+
+// An alternation entered from outside its root must not be rewritten: the
+// SPLIT at 20 leads into the tree of the one at 10, whose second instruction
+// would become the JMP to ACCEPT, so that "x" matched.
+bool checkEnteredAlternation() {
+    const int TYPE_SHIFT = Cicero::BITS_INSTR - Cicero::BITS_INSTR_TYPE;
+    Cicero::Instruction program[Cicero::INSTR_MEM_SIZE] = {};
+    auto put = [&](unsigned short PC, unsigned short type,
+                   unsigned short data) {
+        program[PC] = Cicero::Instruction(type << TYPE_SHIFT | data);
+    };
+    put(0, Cicero::JMP, 3);
+    put(3, Cicero::SPLIT, 10);
+    put(4, Cicero::MATCH, 'x');
+    put(5, Cicero::JMP, 20);
+    put(10, Cicero::SPLIT, 20);
+    put(11, Cicero::MATCH, 'a');
+    put(12, Cicero::JMP, 30);
+    put(20, Cicero::SPLIT, 11);
+    put(21, Cicero::MATCH, 'b');
+    put(22, Cicero::JMP, 30);
+    put(30, Cicero::ACCEPT, 0);
+
+    Cicero::ClassRewriter rewriter(program);
+    Cicero::DecodedProgram rewritten(rewriter.getProgram().data(),
+                                     rewriter.getClasses());
+    Cicero::PikeVM original(program);
+    Cicero::PikeVM classes(rewritten);
+    for (const char *input : {"", "x", "a", "b", "xa", "xb", "ab"}) {
+        if (original.match(input) != classes.match(input)) {
+            std::cerr << "The classes of the entered alternation change the "
+                         "verdict on \""
+                      << input << "\".\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Cicero::ExecutionMode mode;
+    if (!parseMode(argc, argv, mode))
+        return -1;
+
+    // A window wider than a machine word, for the engine bitmaps.
+    bool wide = argc > 2 && std::string(argv[2]) == "wide";
+    auto cicero = Cicero::CiceroMulti(wide ? 100 : 2, false, mode);
 
     std::vector<std::string> inputStrings;
 
@@ -109,23 +378,203 @@ int main() {
     auto correctResults = getCorrectResults();
     int correctResultIndex = 0;
 
-    for (int i = 0; i <= PROGRAMS_COUNT; i++) {
+    Variant variant = parseVariant(argc, argv);
+    bool batch = variant == Variant::BATCH;
+    bool useBundle = variant == Variant::BUNDLE;
+    bool stream = variant == Variant::STREAM;
+    bool scan = variant == Variant::SCAN;
+    bool usePatternSet = variant == Variant::SET;
+    bool smallCache = variant == Variant::SMALL_CACHE;
+    int managerEngines = 0;
+    if (variant == Variant::MANAGER)
+        managerEngines = argc > 3 ? std::atoi(argv[3]) : 4;
+    if (argc > 2 && (std::string(argv[2]) == "noprefilter" || wide))
+        cicero.setPrefilter(false);
+    if (argc > 2 && std::string(argv[2]) == "prefilter")
+        cicero.setPrefilter(true);
+    if (argc > 2 && std::string(argv[argc - 1]) == "optimize")
+        cicero.setOptimization(true);
+    if (argc > 2 && std::string(argv[argc - 1]) == "lowmemory")
+        cicero.setMemoryLimit(1 << 20);
+    bool classes = argc > 2 && std::string(argv[argc - 1]) == "classes";
+    int programStride =
+        argc > 2 && std::string(argv[argc - 1]) == "sample" ? 25 : 1;
+    if (classes) {
+        cicero.setCharacterClasses(true);
+        if (!checkEnteredAlternation())
+            return -1;
+    }
+    if (argc > 2 && std::string(argv[2]) == "dedup") {
+        cicero.setPrefilter(false);
+        cicero.setDeduplication(true);
+    }
+    std::string packedInputs;
+    std::vector<std::string_view> slices; // Of packedInputs, once complete
+    for (auto &inputString : inputStrings) {
+        packedInputs += inputString;
+    }
+    for (size_t j = 0, offset = 0; j < inputStrings.size(); j++) {
+        slices.emplace_back(packedInputs.data() + offset,
+                            inputStrings[j].size());
+        offset += inputStrings[j].size();
+    }
+    // The program being run, for the Manager and the reference PikeVM of
+    // the scans.
+    Cicero::Instruction programMemory[Cicero::INSTR_MEM_SIZE] = {};
+    Cicero::PikeVM reference(programMemory);
+    // A state costs a little over 1 KiB.
+    Cicero::LazyDFA tinyDFA(programMemory, 1200);
+    Cicero::LazyDFA smallDFA(programMemory, 4096);
+    // Same window as cicero, starting with a program that accepts anything.
+    std::unique_ptr<Cicero::Manager> manager;
+    if (managerEngines > 0)
+        manager = std::make_unique<Cicero::Manager>(nullptr, managerEngines,
+                                                    3);
+    std::vector<std::vector<unsigned char>> setMatches; // [input][program]
+    Cicero::BatchResult batchResult;
+    Cicero::ProgramBundle bundle;
+    std::vector<int> bundleIndex(PROGRAMS_COUNT + 1, -1);
+
+    if (useBundle) {
+        std::vector<std::vector<Cicero::Instruction>> programs;
+        Cicero::Instruction program[Cicero::INSTR_MEM_SIZE];
+
+        for (int i = 0; i <= PROGRAMS_COUNT; i++) {
+            std::string programPath =
+                TEST_INPUT_PATH + std::string("programs/") + std::to_string(i);
+            size_t length;
+            if (Cicero::CiceroMulti::readProgram(programPath.c_str(), program,
+                                                 false, &length)) {
+                bundleIndex[i] = programs.size();
+                programs.emplace_back(program, program + length);
+            }
+        }
 
-        std::cout << "\rRunning program number " << i;
-        std::cout.flush();
+        // Named after the options, so that the tests running in parallel
+        // write bundles of their own.
+        std::string bundlePath = "test_programs";
+        for (int i = 1; i < argc; i++) {
+            bundlePath += std::string("_") + argv[i];
+        }
+        bundlePath += ".cicb";
+
+        if (!Cicero::ProgramBundle::write(bundlePath.c_str(), programs) ||
+            !bundle.open(bundlePath.c_str())) {
+            std::cerr << "Unable to write and reopen the program bundle.\n";
+            return -1;
+        }
+
+        // Every program runs once before, in reverse order, so that the
+        // matches below go back to programs already prepared, with DFA
+        // states discovered on the same inputs.
+        for (size_t program = programs.size(); program-- > 0;) {
+            cicero.setProgram(bundle, program);
+            for (auto &inputString : inputStrings) {
+                cicero.match(inputString);
+            }
+        }
+    }
+
+    if (usePatternSet) {
+        Cicero::PatternSet patterns;
+        std::vector<int> programNumbers; // Of each pattern tag
+
+        for (int i = 0; i <= PROGRAMS_COUNT; i++) {
+            std::string programPath =
+                TEST_INPUT_PATH + std::string("programs/") + std::to_string(i);
+            Cicero::Instruction program[Cicero::INSTR_MEM_SIZE] = {};
+            size_t length;
+            if (!Cicero::CiceroMulti::readProgram(programPath.c_str(), program,
+                                                  false, &length))
+                continue;
+
+            bool added;
+            if (classes) {
+                Cicero::ClassRewriter rewriter(program);
+                added = patterns.add(rewriter.getProgram().data(), length,
+                                     rewriter.getClasses());
+            } else {
+                added = patterns.add(program, length);
+            }
+            if (added)
+                programNumbers.push_back(i);
+        }
+
+        for (auto &inputString : inputStrings) {
+            setMatches.emplace_back(PROGRAMS_COUNT + 1, false);
+            for (size_t tag : patterns.match(inputString)) {
+                setMatches.back()[programNumbers[tag]] = true;
+            }
+        }
+    }
+
+    if (batch) {
+        std::vector<std::string> programPaths;
+        for (int i = 0; i <= PROGRAMS_COUNT; i++) {
+            programPaths.push_back(TEST_INPUT_PATH + std::string("programs/") +
+                                   std::to_string(i));
+        }
+        // The second call reuses the threads and workers of the first,
+        // which last bound other programs.
+        std::vector<std::string> reversedPaths(programPaths.rbegin(),
+                                               programPaths.rend());
+        Cicero::BatchResult reversed =
+            cicero.matchBatch(reversedPaths, inputStrings, 4);
+        batchResult = cicero.matchBatch(programPaths, inputStrings, 4);
+        for (int i = 0; i <= PROGRAMS_COUNT; i++) {
+            for (size_t j = 0; j < inputStrings.size(); j++) {
+                if (reversed.isMatch(PROGRAMS_COUNT - i, j) !=
+                    batchResult.isMatch(i, j)) {
+                    std::cerr << "Batches disagree on program " << i
+                              << ", input " << j << ".\n";
+                    return -1;
+                }
+            }
+        }
+    }
 
+    for (int i = 0; i <= PROGRAMS_COUNT; i++) {
         std::string programPath =
             TEST_INPUT_PATH + std::string("programs/") + std::to_string(i);
 
-        cicero.setProgram(programPath.c_str());
+        // Programs left out of the sample still have their results.
+        if (i % programStride != 0) {
+            if (std::ifstream(programPath).good())
+                correctResultIndex += inputStrings.size();
+            continue;
+        }
+
+        std::cout << "\rRunning program number " << i;
+        std::cout.flush();
+
+        if (useBundle && bundleIndex[i] >= 0)
+            cicero.setProgram(bundle, bundleIndex[i]);
+        else
+            cicero.setProgram(programPath.c_str());
 
         if (!cicero.isProgramSet()) {
             std::cerr << "Unable to load program " << programPath << std::endl;
             continue;
         }
 
+        if (manager || scan || smallCache) {
+            Cicero::CiceroMulti::readProgram(programPath.c_str(),
+                                             programMemory);
+            if (manager)
+                manager->setProgram(programMemory);
+            reference.setProgram(programMemory);
+            if (smallCache) {
+                tinyDFA.setProgram(programMemory);
+                smallDFA.setProgram(programMemory);
+            }
+        }
+
+        std::vector<unsigned char> programMatches;
+        if (mode == Cicero::LOCKSTEP)
+            programMatches = cicero.matchAll(inputStrings);
+
         for (int j = 0; j < inputStrings.size(); j++) {
-            auto inputString = inputStrings[j];
+            const std::string &inputString = inputStrings[j];
 
             if (correctResultIndex >= correctResults.size()) {
                 std::cerr << "Regex number " << i << "; input number " << j
@@ -145,7 +594,40 @@ int main() {
                 return -1;
             }
 
-            bool matchResult = cicero.match(inputString.c_str());
+            bool matchResult;
+            switch (variant) {
+            case Variant::MANAGER:
+                matchResult = manager->match(inputString);
+                break;
+            case Variant::BATCH:
+                matchResult = batchResult.isMatch(i, j);
+                break;
+            case Variant::STREAM:
+                matchResult = matchStreamed(cicero, inputString);
+                break;
+            case Variant::SCAN:
+                matchResult = matchScanned(cicero, reference, inputString);
+                break;
+            case Variant::SET:
+                matchResult = setMatches[j][i];
+                break;
+            case Variant::STATS:
+                matchResult = matchWithStats(cicero, inputString);
+                break;
+            case Variant::NOALLOC:
+                matchResult = matchWithoutAllocating(cicero, slices[j]);
+                break;
+            case Variant::SMALL_CACHE:
+                matchResult = matchSmallCaches(tinyDFA, smallDFA, inputString);
+                break;
+            case Variant::BUNDLE:
+            case Variant::MATCH:
+            default:
+                matchResult = mode == Cicero::LOCKSTEP
+                                  ? bool(programMatches[j])
+                                  : cicero.match(inputString);
+                break;
+            }
             if (matchResult != correctResult.matchResult) {
                 std::cerr << "Regex number " << i << "; input number " << j
                           << "; resultIndex = " << correctResultIndex
@@ -156,4 +638,16 @@ int main() {
             }
         }
     }
+
+    // Reading a directory fails: the input does not match, whatever the
+    // program, and the error is reported.
+    if (stream) {
+        int fd = open(TEST_INPUT_PATH, O_RDONLY | O_DIRECTORY);
+        bool result = cicero.matchStream(fd);
+        close(fd);
+        if (result || cicero.getStreamError() != EISDIR) {
+            std::cerr << "A failed read was taken for the end of the input.\n";
+            return -1;
+        }
+    }
 }
\ No newline at end of file